@@ -4,6 +4,8 @@
 #include "csvmonkey.hpp"
 #include "iterator_stream_cursor.hpp"
 #include "file_stream_cursor.hpp"
+#include "read_ahead_cursor.hpp"
+#include "multi_file_cursor.hpp"
 
 using namespace csvmonkey;
 
@@ -17,7 +19,10 @@ enum CursorType
 {
     CURSOR_MAPPED_FILE,
     CURSOR_ITERATOR,
-    CURSOR_PYTHON_FILE
+    CURSOR_PYTHON_FILE,
+    CURSOR_READ_AHEAD_ITERATOR,
+    CURSOR_READ_AHEAD_FILE,
+    CURSOR_MULTI_FILE
 };
 
 
@@ -153,6 +158,19 @@ cell_as_double(CellObject *self)
 }
 
 
+static PyObject *
+cell_as_timestamp(CellObject *self)
+{
+    int64_t micros;
+    if(self->cell->as_timestamp(micros) != kCsmNumberOk) {
+        auto s = self->cell->as_str();
+        PyErr_Format(PyExc_ValueError, "invalid timestamp: %.64s", s.c_str());
+        return NULL;
+    }
+    return PyLong_FromLongLong(micros);
+}
+
+
 static PyObject *
 cell_as_str(CellObject *self)
 {
@@ -522,6 +540,15 @@ delete_cursor(CursorType type, StreamCursor *cursor)
     case CURSOR_PYTHON_FILE:
         delete (FileStreamCursor *)cursor;
         break;
+    case CURSOR_READ_AHEAD_ITERATOR:
+        delete (PyReadAheadCursor<IteratorStreamCursor> *)cursor;
+        break;
+    case CURSOR_READ_AHEAD_FILE:
+        delete (PyReadAheadCursor<FileStreamCursor> *)cursor;
+        break;
+    case CURSOR_MULTI_FILE:
+        delete (PyMultiFileCursor *)cursor;
+        break;
     default:
         assert(0);
     }
@@ -741,12 +768,86 @@ reader_from_path(PyObject *_self, PyObject *args, PyObject *kw)
 }
 
 
+static PyObject *
+reader_from_paths(PyObject *_self, PyObject *args, PyObject *kw)
+{
+    static char *keywords[] = {"paths", "yields", "header", "delimiter",
+        "quotechar", "escapechar", "yield_incomplete_row",
+        "encoding", "errors", NULL};
+    PyObject *py_paths;
+    const char *yields = "row";
+    PyObject *header = NULL;
+    char delimiter = ',';
+    char quotechar = '"';
+    char escapechar = 0;
+    int yield_incomplete_row = 0;
+    const char *encoding = 0;
+    const char *errors = 0;
+
+    if(! PyArg_ParseTupleAndKeywords(args, kw, "O|sOccciss:from_paths",
+            keywords,
+            &py_paths, &yields, &header, &delimiter, &quotechar, &escapechar,
+            &yield_incomplete_row, &encoding, &errors)) {
+        return NULL;
+    }
+
+    PyObject *seq = PySequence_Fast(py_paths, "paths must be a sequence");
+    if(! seq) {
+        return NULL;
+    }
+
+    std::vector<std::string> paths;
+    for(Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+#if PY_MAJOR_VERSION >= 3
+        PyObject *bytes;
+        if(! PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(seq, i), &bytes)) {
+            Py_DECREF(seq);
+            return NULL;
+        }
+        paths.push_back(PyBytes_AS_STRING(bytes));
+        Py_DECREF(bytes);
+#else
+        const char *path = PyString_AsString(PySequence_Fast_GET_ITEM(seq, i));
+        if(! path) {
+            Py_DECREF(seq);
+            return NULL;
+        }
+        paths.push_back(path);
+#endif
+    }
+    Py_DECREF(seq);
+
+    // Repeated header rows are only present when the first row is the header.
+    bool dedup = header && PyObject_IsTrue(header) && !PySequence_Check(header);
+    PyMultiFileCursor *cursor;
+    try {
+        cursor = new PyMultiFileCursor(paths, dedup, quotechar);
+    } catch(csvmonkey::Error &e) {
+        PyErr_SetString(PyExc_IOError, e.what());
+        return NULL;
+    }
+
+    return reader_from_cursor(
+        CURSOR_MULTI_FILE,
+        cursor,
+        yields,
+        header,
+        delimiter,
+        quotechar,
+        escapechar,
+        yield_incomplete_row,
+        encoding,
+        errors
+    );
+}
+
+
 static PyObject *
 reader_from_iter(PyObject *_self, PyObject *args, PyObject *kw)
 {
     static char *keywords[] = {"iter", "yields", "header",
         "delimiter", "quotechar", "escapechar", "yield_incomplete_row",
-        "encoding", "errors"};
+        "encoding", "errors", "read_ahead", NULL};
     PyObject *iterable;
     const char *yields = "row";
     PyObject *header = NULL;
@@ -756,11 +857,12 @@ reader_from_iter(PyObject *_self, PyObject *args, PyObject *kw)
     int yield_incomplete_row = 0;
     const char *encoding = 0;
     const char *errors = 0;
+    int read_ahead = 0;
 
-    if(! PyArg_ParseTupleAndKeywords(args, kw, "O|sOccciss:from_iter",
+    if(! PyArg_ParseTupleAndKeywords(args, kw, "O|sOcccissi:from_iter",
             keywords,
             &iterable, &yields, &header, &delimiter, &quotechar, &escapechar,
-            &yield_incomplete_row, &encoding, &errors)) {
+            &yield_incomplete_row, &encoding, &errors, &read_ahead)) {
         return NULL;
     }
 
@@ -769,9 +871,21 @@ reader_from_iter(PyObject *_self, PyObject *args, PyObject *kw)
         return NULL;
     }
 
+    CursorType cursor_type = CURSOR_ITERATOR;
+    StreamCursor *cursor;
+    if(read_ahead) {
+#if PY_VERSION_HEX < 0x03070000
+        PyEval_InitThreads();
+#endif
+        cursor_type = CURSOR_READ_AHEAD_ITERATOR;
+        cursor = new PyReadAheadCursor<IteratorStreamCursor>(new IteratorStreamCursor(iter));
+    } else {
+        cursor = new IteratorStreamCursor(iter);
+    }
+
     return reader_from_cursor(
-        CURSOR_ITERATOR,
-        new IteratorStreamCursor(iter),
+        cursor_type,
+        cursor,
         yields,
         header,
         delimiter,
@@ -789,7 +903,7 @@ reader_from_file(PyObject *_self, PyObject *args, PyObject *kw)
 {
     static char *keywords[] = {"fp", "yields", "header",
         "delimiter", "quotechar", "escapechar", "yield_incomplete_row",
-        "encoding", "errors"};
+        "encoding", "errors", "read_ahead", NULL};
     PyObject *fp;
     const char *yields = "row";
     PyObject *header = NULL;
@@ -799,10 +913,11 @@ reader_from_file(PyObject *_self, PyObject *args, PyObject *kw)
     int yield_incomplete_row = 0;
     const char *encoding = 0;
     const char *errors = 0;
+    int read_ahead = 0;
 
-    if(! PyArg_ParseTupleAndKeywords(args, kw, "O|sOccciss:from_file", keywords,
+    if(! PyArg_ParseTupleAndKeywords(args, kw, "O|sOcccissi:from_file", keywords,
             &fp, &yields, &header, &delimiter, &quotechar, &escapechar,
-            &yield_incomplete_row, &encoding, &errors)) {
+            &yield_incomplete_row, &encoding, &errors, &read_ahead)) {
         return NULL;
     }
 
@@ -812,9 +927,21 @@ reader_from_file(PyObject *_self, PyObject *args, PyObject *kw)
         return NULL;
     }
 
+    CursorType cursor_type = CURSOR_PYTHON_FILE;
+    StreamCursor *cursor;
+    if(read_ahead) {
+#if PY_VERSION_HEX < 0x03070000
+        PyEval_InitThreads();
+#endif
+        cursor_type = CURSOR_READ_AHEAD_FILE;
+        cursor = new PyReadAheadCursor<FileStreamCursor>(new FileStreamCursor(py_read));
+    } else {
+        cursor = new FileStreamCursor(py_read);
+    }
+
     return reader_from_cursor(
-        CURSOR_PYTHON_FILE,
-        new FileStreamCursor(py_read),
+        cursor_type,
+        cursor,
         yields,
         header,
         delimiter,
@@ -893,7 +1020,8 @@ reader_iternext(ReaderObject *self)
         return self->yields((RowObject *) self->py_row);
     }
 
-    if(self->cursor->size() && !self->reader->in_newline_skip) {
+    if(self->cursor->size() && !self->reader->in_newline_skip
+            && !PyErr_Occurred()) {
         PyErr_Format(PyExc_IOError,
             "%lu unparsed bytes at end of input. The input may be missing a "
             "final newline, or unbalanced quotes are present.",
@@ -913,6 +1041,7 @@ reader_iternext(ReaderObject *self)
 
 static PyMethodDef cell_methods[] = {
     {"as_double",   (PyCFunction)cell_as_double, METH_NOARGS, ""},
+    {"as_timestamp", (PyCFunction)cell_as_timestamp, METH_NOARGS, ""},
     {"as_str",      (PyCFunction)cell_as_str, METH_NOARGS, ""},
     {"equals",      (PyCFunction)cell_equals, METH_VARARGS, ""},
     {0, 0, 0, 0}
@@ -1060,6 +1189,7 @@ PyTypeObject ReaderType = {
 
 static struct PyMethodDef module_methods[] = {
     {"from_path", (PyCFunction) reader_from_path, METH_VARARGS|METH_KEYWORDS},
+    {"from_paths", (PyCFunction) reader_from_paths, METH_VARARGS|METH_KEYWORDS},
     {"from_iter", (PyCFunction) reader_from_iter, METH_VARARGS|METH_KEYWORDS},
     {"from_file", (PyCFunction) reader_from_file, METH_VARARGS|METH_KEYWORDS},
     {0, 0, 0, 0}
@@ -0,0 +1,24 @@
+/**
+ * MultiFileCursor reporting errors opening or verifying later files as
+ * Python exceptions, since they are only discovered from fill().
+ */
+class PyMultiFileCursor
+    : public csvmonkey::MultiFileCursor
+{
+    public:
+    PyMultiFileCursor(const std::vector<std::string> &paths, bool header,
+                      char quotechar)
+        : MultiFileCursor(paths, header, 0, quotechar)
+    {
+    }
+
+    bool fill()
+    {
+        try {
+            return MultiFileCursor::fill();
+        } catch(csvmonkey::Error &e) {
+            PyErr_SetString(PyExc_IOError, e.what());
+            return false;
+        }
+    }
+};
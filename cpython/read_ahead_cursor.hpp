@@ -0,0 +1,74 @@
+/**
+ * ReadAheadStreamCursor owning a Python-backed source cursor. The background
+ * thread holds the GIL while calling into the source, and the reader's thread
+ * releases it while waiting on the background thread. Since the source's own
+ * IO (e.g. io.FileIO.read()) releases the GIL, it then overlaps with parsing.
+ * Python exceptions raised by the source are moved back to the reader's
+ * thread and reported once earlier input has been consumed.
+ */
+template<class Source>
+class PyReadAheadCursor
+    : public csvmonkey::ReadAheadStreamCursor
+{
+    Source *source_;
+    PyGILState_STATE gil_;
+    PyThreadState *save_;
+    PyObject *type_;
+    PyObject *value_;
+    PyObject *traceback_;
+
+    protected:
+    void source_begin()
+    {
+        gil_ = PyGILState_Ensure();
+    }
+
+    void source_end()
+    {
+        if(PyErr_Occurred()) {
+            PyErr_Fetch(&type_, &value_, &traceback_);
+        }
+        PyGILState_Release(gil_);
+    }
+
+    void wait_begin()
+    {
+        save_ = PyEval_SaveThread();
+    }
+
+    void wait_end()
+    {
+        PyEval_RestoreThread(save_);
+    }
+
+    public:
+    PyReadAheadCursor(Source *source)
+        : ReadAheadStreamCursor(*source)
+        , source_(source)
+        , save_(0)
+        , type_(0)
+        , value_(0)
+        , traceback_(0)
+    {
+    }
+
+    ~PyReadAheadCursor()
+    {
+        stop();
+        Py_XDECREF(type_);
+        Py_XDECREF(value_);
+        Py_XDECREF(traceback_);
+        delete source_;
+    }
+
+    virtual ssize_t readmore()
+    {
+        ssize_t rc = ReadAheadStreamCursor::readmore();
+        if(rc <= 0 && type_) {
+            PyErr_Restore(type_, value_, traceback_);
+            type_ = value_ = traceback_ = 0;
+            return -1;
+        }
+        return rc;
+    }
+};
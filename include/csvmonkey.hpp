@@ -1,30 +1,81 @@
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <condition_variable>
 #include <cstring>
+#ifdef __GLIBCXX__
+#include <cxxabi.h>
+#endif
+#include <deque>
 #include <exception>
 #include <fcntl.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <poll.h>
 #include <stdexcept>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
-#if defined(__SSE4_2__) && !defined(CSM_IGNORE_SSE42)
+/*
+ * Vectorized kernels are always compiled on x86 using target attributes, and
+ * selected at runtime according to CPU support. CSM_USE_SSE42 only controls
+ * the default StringSpanner.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(CSM_IGNORE_X86)
+#define CSM_X86
+#include <immintrin.h>
+#   define CSM_ATTR_SSE42 __attribute__((target("sse4.2")))
+#   define CSM_ATTR_AVX2 __attribute__((target("avx2")))
+#   define CSM_ATTR_AVX512BW __attribute__((target("avx512bw")))
+#   define CSM_ATTR_PCLMUL __attribute__((target("pclmul")))
+#else
+#warning Using non-SSE4.2 fallback implementation.
+#endif // __x86_64__
+
+#if defined(CSM_X86) && defined(__SSE4_2__) && !defined(CSM_IGNORE_SSE42)
 #define CSM_USE_SSE42
-#include <emmintrin.h>
-#include <smmintrin.h>
 #endif // __SSE4_2__
 
 #ifdef USE_SPIRIT
 #include "boost/spirit/include/qi.hpp"
 #endif
 
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+
+/*
+ * IoUringStreamCursor talks to the kernel directly rather than via liburing.
+ * Without io_uring headers, it always uses its thread fallback.
+ */
+#if defined(__linux__) && defined(__has_include) && !defined(CSM_IGNORE_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_OFF_SQES)
+#define CSM_USE_IO_URING
+#endif
+#endif
+#endif // __linux__
+
 
 #ifdef CSVMONKEY_DEBUG
 #   define CSM_DEBUG(x, ...) fprintf(stderr, "csvmonkey: " x "\n", ##__VA_ARGS__);
@@ -78,6 +129,39 @@ class StreamCursor
 };
 
 
+/**
+ * Options for MappedFileCursor::open().
+ */
+enum CsmMapFlags
+{
+    /// Read the file and populate page tables during open() (MAP_POPULATE,
+    /// where available).
+    kCsmMapPopulate = 1,
+    /// Align the mapping to 2 MiB and request transparent huge pages.
+    kCsmMapHugePages = 2,
+    /// Touch each page from a background thread, ahead of the parser.
+    kCsmMapPrefault = 4
+};
+
+
+/**
+ * Return the modification time in `st` in nanoseconds since the epoch, at
+ * whole second resolution where the platform lacks a nanosecond field.
+ */
+inline int64_t
+stat_mtime_ns(const struct stat &st)
+{
+#if defined(__APPLE__)
+    return ((int64_t) st.st_mtimespec.tv_sec * 1000000000) + st.st_mtimespec.tv_nsec;
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) \
+    || defined(__OpenBSD__)
+    return ((int64_t) st.st_mtim.tv_sec * 1000000000) + st.st_mtim.tv_nsec;
+#else
+    return (int64_t) st.st_mtime * 1000000000;
+#endif
+}
+
+
 class MappedFileCursor
     : public StreamCursor
 {
@@ -85,29 +169,139 @@ class MappedFileCursor
     char *endp_;
     char *p_;
     char *guardp_;
+    int64_t mtime_ns_;
+
+    // Windowed mode: pages below dropp_ have been released, pages below
+    // prefetchp_ have been requested, and slide() runs once p_ passes
+    // triggerp_.
+    size_t window_;
+    char *dropp_;
+    char *prefetchp_;
+    char *triggerp_;
+
+    // Prefault thread, which stays below prefault_limit_ in windowed mode.
+    std::thread prefault_;
+    std::mutex prefault_mutex_;
+    std::condition_variable prefault_cond_;
+    char *prefault_limit_;
+    std::atomic<bool> prefault_stop_;
 
     size_t get_page_size()
     {
         return (size_t) sysconf(_SC_PAGESIZE);
     }
 
+    char *page_floor(char *p)
+    {
+        return startp_ + ((p - startp_) & ~(get_page_size() - 1));
+    }
+
+    /**
+     * Release pages more than window_ bytes behind p_, and request the
+     * window_ bytes following it.
+     */
+    void slide()
+    {
+        char *behind = page_floor(p_ - std::min(window_, (size_t) (p_ - startp_)));
+        if(p_ < dropp_) {
+            // Seeked backwards, pages will fault back in.
+            dropp_ = prefetchp_ = page_floor(p_);
+        } else if(behind > dropp_) {
+#ifdef MADV_COLD
+            // Deprioritize in the page cache, not just our mapping.
+            ::madvise(dropp_, behind - dropp_, MADV_COLD);
+#endif
+            ::madvise(dropp_, behind - dropp_, MADV_DONTNEED);
+            dropp_ = behind;
+        }
+
+        char *ahead = p_ + std::min(window_, (size_t) (endp_ - p_));
+        char *from = std::max(prefetchp_, page_floor(p_));
+        if(ahead > from) {
+            ::madvise(from, ahead - from, MADV_WILLNEED);
+            prefetchp_ = ahead;
+        }
+        triggerp_ = p_ + std::max(window_ / 4, get_page_size());
+
+        if(prefault_.joinable()) {
+            std::lock_guard<std::mutex> lock(prefault_mutex_);
+            prefault_limit_ = prefetchp_;
+            prefault_cond_.notify_all();
+        }
+    }
+
+    /**
+     * Touch one byte of each page, so the parser rarely takes page faults.
+     */
+    void prefault()
+    {
+        size_t page_size = get_page_size();
+        char *limit = endp_;
+        volatile char sink;
+        for(char *p = startp_; p < endp_; p += page_size) {
+            if(window_ && p >= limit) {
+                std::unique_lock<std::mutex> lock(prefault_mutex_);
+                prefault_cond_.wait(lock, [&] {
+                    return prefault_stop_ || p < prefault_limit_;
+                });
+                limit = prefault_limit_;
+            }
+            if(prefault_stop_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            sink = *p;
+        }
+        (void) sink;
+    }
+
+    void stop_prefault()
+    {
+        if(prefault_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(prefault_mutex_);
+                prefault_stop_ = true;
+                prefault_cond_.notify_all();
+            }
+            prefault_.join();
+        }
+        prefault_stop_ = false;
+    }
+
+    /**
+     * Stop any prefault thread, and unmap the file and guard page.
+     */
+    void unmap()
+    {
+        stop_prefault();
+        if(endp_ > startp_) {
+            ::munmap(startp_, endp_ - startp_);
+        }
+        if(guardp_) {
+            ::munmap(guardp_, get_page_size());
+        }
+        startp_ = endp_ = p_ = guardp_ = 0;
+        dropp_ = prefetchp_ = triggerp_ = 0;
+    }
+
     public:
     MappedFileCursor()
         : startp_(0)
         , endp_(0)
         , p_(0)
         , guardp_(0)
+        , mtime_ns_(0)
+        , window_(0)
+        , dropp_(0)
+        , prefetchp_(0)
+        , triggerp_(0)
+        , prefault_limit_(0)
+        , prefault_stop_(false)
     {
     }
 
     ~MappedFileCursor()
     {
-        if(startp_) {
-            ::munmap(startp_, endp_ - startp_);
-        }
-        if(guardp_) {
-            ::munmap(guardp_, get_page_size());
-        }
+        unmap();
     }
 
     const char *buf()
@@ -123,6 +317,9 @@ class MappedFileCursor
     void consume(size_t n)
     {
         p_ += std::min(n, (size_t) (endp_ - p_));
+        if(triggerp_ && p_ >= triggerp_) {
+            slide();
+        }
         CSM_DEBUG("consume(%lu); new size: %lu", n, size())
     }
 
@@ -131,8 +328,66 @@ class MappedFileCursor
         return false;
     }
 
-    void open(const char *filename)
+    /**
+     * Bound resident memory on huge files: once set, only about `window`
+     * bytes either side of the position reached by consume() or seek() stay
+     * mapped. Pages further behind are released using MADV_DONTNEED (and
+     * MADV_COLD where available), and only the following `window` bytes are
+     * prefetched, rather than the whole file. Zero restores the default of
+     * prefetching everything and releasing nothing. May be called before or
+     * after open(), but before open() when using kCsmMapPrefault, whose
+     * thread then stays within the window.
+     */
+    void set_window(size_t window)
+    {
+        window_ = window;
+        triggerp_ = 0;
+        if(window_ && startp_) {
+            slide();
+        }
+    }
+
+    /**
+     * Return the start of the mapped file, regardless of the current
+     * position.
+     */
+    const char *startp() const
+    {
+        return startp_;
+    }
+
+    size_t file_size() const
+    {
+        return endp_ - startp_;
+    }
+
+    /**
+     * Return the file's modification time when it was opened, in
+     * nanoseconds since the epoch.
+     */
+    int64_t mtime_ns() const
+    {
+        return mtime_ns_;
+    }
+
+    /**
+     * Reposition the cursor `offset` bytes from the start of the file.
+     */
+    void seek(size_t offset)
+    {
+        p_ = startp_ + std::min(offset, file_size());
+        if(triggerp_) {
+            slide();
+        }
+    }
+
+    /**
+     * Map `filename`, with `flags` a combination of CsmMapFlags, replacing
+     * any file previously opened. Throws Error on failure.
+     */
+    void open(const char *filename, int flags=0)
     {
+        unmap();
         int fd = ::open(filename, O_RDONLY);
         if(fd == -1) {
             throw Error(filename, strerror(errno));
@@ -169,16 +424,37 @@ class MappedFileCursor
             ? ((st.st_size & ~page_mask) + page_size)
             : st.st_size;
 
-        auto startp = (char *) mmap(0, rounded+page_size, PROT_READ,
-                                    MAP_ANON|MAP_PRIVATE, 0, 0);
-        if(! startp) {
+        // Huge pages can only back 2 MiB aligned ranges, so over-allocate the
+        // reservation and trim it either side of an aligned start.
+        size_t align = (flags & kCsmMapHugePages) ? (2 << 20) : page_size;
+        size_t reserve = rounded + page_size + (align - page_size);
+        auto basep = (char *) mmap(0, reserve, PROT_READ,
+                                   MAP_ANON|MAP_PRIVATE, 0, 0);
+        if(basep == MAP_FAILED) {
             ::close(fd);
             throw Error("mmap", "could not allocate guard page");
         }
 
+        auto startp = (char *) (((uintptr_t) basep + align - 1) & ~(uintptr_t) (align - 1));
+        if(startp > basep) {
+            ::munmap(basep, startp - basep);
+        }
+        char *reservep = startp + rounded + page_size;
+        if(basep + reserve > reservep) {
+            ::munmap(reservep, (basep + reserve) - reservep);
+        }
+
         guardp_ = startp + rounded;
-        startp_ = (char *) mmap(startp, st.st_size, PROT_READ,
-                                MAP_SHARED|MAP_FIXED, fd, 0);
+        int map_flags = MAP_SHARED|MAP_FIXED;
+#ifdef MAP_POPULATE
+        if(flags & kCsmMapPopulate) {
+            map_flags |= MAP_POPULATE;
+        }
+#endif
+        // Empty files cannot be mapped, and are represented by the guard page.
+        startp_ = st.st_size
+            ? (char *) mmap(startp, st.st_size, PROT_READ, map_flags, fd, 0)
+            : startp;
         ::close(fd);
 
         if(startp_ != startp) {
@@ -188,576 +464,6966 @@ class MappedFileCursor
         }
 
         ::madvise(startp_, st.st_size, MADV_SEQUENTIAL);
-        ::madvise(startp_, st.st_size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+        if(flags & kCsmMapHugePages) {
+            ::madvise(startp_, st.st_size, MADV_HUGEPAGE);
+        }
+#endif
         endp_ = startp_ + st.st_size;
         p_ = startp_;
+        dropp_ = prefetchp_ = startp_;
+        if(window_) {
+            slide();
+        } else {
+            ::madvise(startp_, st.st_size, MADV_WILLNEED);
+        }
+        mtime_ns_ = stat_mtime_ns(st);
+
+        if(flags & kCsmMapPrefault) {
+            prefault_limit_ = prefetchp_;
+            prefault_ = std::thread(&MappedFileCursor::prefault, this);
+        }
     }
 };
 
 
-class BufferedStreamCursor
+/**
+ * Present a sequence of files as one stream, as if concatenated, mapping each
+ * using MappedFileCursor. The next file is opened on a background thread
+ * while the current one is parsed. A final row lacking its newline is
+ * terminated before the following file begins.
+ *
+ * When `header` is true, each file's header row is compared with the first
+ * file's, ignoring line endings, and dropped from all but the first. A
+ * mismatch causes Error to be thrown from fill(), as do errors opening files
+ * after the first. Once fill() has thrown, every later call rethrows the same
+ * error, and no data from the offending file is presented.
+ *
+ * Mapped data is presented directly, except that a row left incomplete at
+ * the end of a file is copied with the start of the following file into a
+ * small bridging buffer, which is only non-empty for malformed input or
+ * files lacking a final newline.
+ */
+class MultiFileCursor
     : public StreamCursor
 {
-    protected:
-    std::vector<char> vec_;
-    size_t read_pos_;
-    size_t write_pos_;
+    std::vector<std::string> paths_;
+    bool header_;
+    int flags_;
+    char quotechar_;
+    /// First file's header row, or empty if not yet seen.
+    std::string header_row_;
+    size_t header_index_;
 
-    virtual ssize_t readmore() = 0;
+    size_t index_;
+    std::unique_ptr<MappedFileCursor> file_;
+    std::unique_ptr<MappedFileCursor> next_;
+    std::exception_ptr next_error_;
+    std::thread prefetch_;
+    /// Error thrown by fill(), rethrown by every later call.
+    std::exception_ptr error_;
 
-    BufferedStreamCursor()
-        : vec_(131072)
-        , read_pos_(0)
-        , write_pos_(0)
+    /// Bridging buffer: carry_[carry_pos_..carry_len_] precedes file_'s data.
+    std::vector<char> carry_;
+    size_t carry_pos_;
+    size_t carry_len_;
+
+    /**
+     * Return the length of the record starting at `p`, including its
+     * newline, determined by quote parity.
+     */
+    size_t record_size(const char *p, size_t size)
+    {
+        bool quoted = false;
+        for(size_t i = 0; i < size; i++) {
+            if(p[i] == quotechar_) {
+                quoted = !quoted;
+            } else if(p[i] == '\n' && !quoted) {
+                return i + 1;
+            }
+        }
+        return size;
+    }
+
+    static size_t strip_eol(const char *p, size_t size)
     {
+        if(size && p[size - 1] == '\n') {
+            size--;
+        }
+        if(size && p[size - 1] == '\r') {
+            size--;
+        }
+        return size;
     }
 
-    protected:
-    void ensure(size_t capacity)
+    /**
+     * Record the header row of the first non-empty file, or verify and skip
+     * it for subsequent files. `file` is the file at `index` within `paths_`.
+     */
+    void strip_header(MappedFileCursor &file, size_t index)
     {
-        size_t available = vec_.size() - write_pos_;
-        if(available < capacity) {
-            CSM_DEBUG("resizing vec_ %lu", (size_t)(vec_.size() + capacity));
-            vec_.resize(32 + (vec_.size() + capacity));
+        if(! (header_ && file.size())) {
+            return;
+        }
+
+        const char *p = file.buf();
+        size_t size = record_size(p, file.size());
+        if(header_row_.empty()) {
+            header_row_.assign(p, size);
+            header_index_ = index;
+            return;
+        }
+
+        size_t len = strip_eol(p, size);
+        if(len != strip_eol(header_row_.data(), header_row_.size())
+                || memcmp(p, header_row_.data(), len)) {
+            throw Error(paths_[index].c_str(),
+                "header row differs from " + paths_[header_index_]);
         }
+        file.consume(size);
     }
 
-    public:
-    const char *buf()
+    void prefetch(size_t index)
     {
-        return &vec_[0] + read_pos_;
+        if(index >= paths_.size()) {
+            return;
+        }
+        prefetch_ = std::thread([this, index] {
+            try {
+                std::unique_ptr<MappedFileCursor> file(new MappedFileCursor());
+                file->open(paths_[index].c_str(), flags_);
+                next_ = std::move(file);
+            } catch(...) {
+                next_error_ = std::current_exception();
+            }
+        });
     }
 
-    size_t size()
+    /**
+     * Move to the next non-empty file, returning false if none remain.
+     */
+    bool next_file()
     {
-        return write_pos_ - read_pos_;
+        while(index_ + 1 < paths_.size()) {
+            if(prefetch_.joinable()) {
+                prefetch_.join();
+            }
+            if(next_error_) {
+                std::rethrow_exception(next_error_);
+            }
+
+            // Verified before switching, so a mismatch leaves file_ alone.
+            std::unique_ptr<MappedFileCursor> file = std::move(next_);
+            strip_header(*file, index_ + 1);
+            file_ = std::move(file);
+            index_++;
+            prefetch(index_ + 1);
+            if(file_->size()) {
+                return true;
+            }
+        }
+        return false;
     }
 
-    void consume(size_t n)
+    void append(const char *p, size_t n)
     {
-        read_pos_ += std::min(n, write_pos_ - read_pos_);
-        CSM_DEBUG("consume(%lu); new size: %lu", n, size())
+        if(carry_.size() < (carry_len_ + n + 32)) {
+            carry_.resize(std::max(2 * carry_.size(), carry_len_ + n + 32));
+        }
+        memcpy(&carry_[carry_len_], p, n);
+        carry_len_ += n;
+        memset(&carry_[carry_len_], 0, 32);
     }
 
-    virtual bool fill()
+    /**
+     * Append following input to the bridging buffer.
+     */
+    bool bridge()
     {
-        if(read_pos_) {
-            size_t n = write_pos_ - read_pos_;
-            CSM_DEBUG("read_pos_ needs adjust, it is %lu / n = %lu", read_pos_, n);
-            memcpy(&vec_[0], &vec_[read_pos_], n);
-            CSM_DEBUG("fill() adjust old write_pos = %lu", write_pos_);
-            write_pos_ -= read_pos_;
-            read_pos_ = 0;
-            CSM_DEBUG("fill() adjust new write_pos = %lu", write_pos_);
+        while(! file_->size()) {
+            if(! next_file()) {
+                return false;
+            }
         }
 
-        if(write_pos_ == vec_.size()) {
-            ensure(vec_.size() / 2);
+        size_t n = std::min(file_->size(), std::max(carry_len_, (size_t) 65536));
+        append(file_->buf(), n);
+        file_->consume(n);
+        return true;
+    }
+
+    /**
+     * Present more input, returning false once all files are exhausted.
+     */
+    bool advance()
+    {
+        if(carry_pos_ < carry_len_) {
+            carry_len_ -= carry_pos_;
+            memmove(&carry_[0], &carry_[carry_pos_], carry_len_);
+            carry_pos_ = 0;
+            return bridge();
         }
 
-        ssize_t rc = readmore();
-        if(rc == -1) {
-            CSM_DEBUG("readmore() failed");
+        carry_pos_ = carry_len_ = 0;
+        size_t n = file_->size();
+        if(! n) {
+            return next_file();
+        } else if(index_ + 1 == paths_.size()) {
             return false;
         }
 
-        CSM_DEBUG("readmore() succeeded")
-        CSM_DEBUG("fill() old write_pos = %lu", write_pos_);
-        write_pos_ += rc;
-        CSM_DEBUG("fill() new write_pos = %lu", write_pos_);
-        return write_pos_ > 0;
+        // An incomplete row ends this file.
+        const char *p = file_->buf();
+        append(p, n);
+        file_->consume(n);
+        if(p[n - 1] != '\n') {
+            append("\n", 1);
+            return true;
+        }
+        return bridge();
     }
-};
-
-
-class FdStreamCursor
-    : public BufferedStreamCursor
-{
-    int fd_;
 
     public:
-    FdStreamCursor(int fd)
-        : BufferedStreamCursor()
-        , fd_(fd)
+    /**
+     * Open the first of `paths`, with `flags` a combination of CsmMapFlags
+     * applied to every file. Throws Error if `paths` is empty or the first
+     * file cannot be opened.
+     */
+    MultiFileCursor(const std::vector<std::string> &paths, bool header=true,
+                    int flags=0, char quotechar='"')
+        : paths_(paths)
+        , header_(header)
+        , flags_(flags)
+        , quotechar_(quotechar)
+        , header_index_(0)
+        , index_(0)
+        , carry_pos_(0)
+        , carry_len_(0)
     {
+        if(paths_.empty()) {
+            throw Error("MultiFileCursor", "no paths given");
+        }
+        file_.reset(new MappedFileCursor());
+        file_->open(paths_[0].c_str(), flags_);
+        strip_header(*file_, 0);
+        prefetch(1);
     }
 
-    virtual ssize_t readmore()
+    ~MultiFileCursor()
     {
-        return ::read(fd_, &vec_[write_pos_], vec_.size() - write_pos_);
+        if(prefetch_.joinable()) {
+            prefetch_.join();
+        }
     }
-};
 
+    /**
+     * Return the index within `paths` of the file currently being read.
+     */
+    size_t file_index() const
+    {
+        return index_;
+    }
 
-struct CsvCell
-{
-    const char *ptr;
-    size_t size;
-
-    char escapechar;
-    char quotechar;
-    bool escaped;
-
-    std::string as_str()
+    const char *buf()
     {
-        auto s = std::string(ptr, size);
-        if(escaped) {
-            int o = 0;
-            for(size_t i = 0; i < s.size();) {
-                char c = s[i];
-                if((escapechar && c == escapechar) || (c == quotechar)) {
-                    i++;
-                }
-                s[o++] = s[i++];
-            }
-            s.resize(o);
+        if(carry_pos_ < carry_len_) {
+            return &carry_[carry_pos_];
         }
-        return s;
+        return file_->buf();
     }
 
-    bool startswith(const char *str) const
+    size_t size()
     {
-        return std::string(ptr, std::min(size, strlen(str))) == str;
+        if(carry_pos_ < carry_len_) {
+            return carry_len_ - carry_pos_;
+        }
+        return file_->size();
     }
 
-    bool equals(const char *str) const
+    void consume(size_t n)
     {
-        auto p = ptr;
-        for(auto len = size; len--;) {
-            if((! *p) || *str++ != *p++) {
-                return false;
-            }
+        if(carry_pos_ < carry_len_) {
+            carry_pos_ += std::min(n, carry_len_ - carry_pos_);
+        } else {
+            file_->consume(n);
         }
-        return true;
     }
 
-    double as_double()
+    bool fill()
     {
-#ifdef USE_SPIRIT
-        namespace qi = boost::spirit::qi;
-        using qi::double_;
-        double n;
-        qi::parse(ptr, ptr+size, double_, n);
-        return n;
-#else
-        return strtod(ptr, NULL);
-#endif
+        if(error_) {
+            std::rethrow_exception(error_);
+        }
+        try {
+            return advance();
+        } catch(...) {
+            error_ = std::current_exception();
+            throw;
+        }
     }
 };
 
 
-struct FieldPair
-{
-    const char *name;
-    CsvCell **cell;
-};
-
-
-#ifndef CSM_USE_SSE42
-#warning Using non-SSE4.2 fallback implementation.
 /**
- * Callable that matches a set of up to 5 bytes (including NUL) in a 16 byte
- * string. The index 0..15 of the first occurrence is returned, otherwise 16 is
- * returned if no match is found or NUL is encountered.
+ * Buffer for BufferedStreamCursor, whose pages are mapped twice back to back
+ * so that up to capacity() bytes starting anywhere below capacity() are
+ * contiguous, and the unconsumed tail of a ring never needs to be moved. One
+ * further page mirroring the start follows the second copy, keeping reads
+ * past the end readable. Where memfd_create() is unavailable, falls back to a
+ * plain allocation with mirrored() false.
+ *
+ * Exposes the subset of std::vector used by BufferedStreamCursor subclasses.
+ * size() is not the capacity, but the offset up to which data may be written
+ * without overwriting unconsumed input, as maintained by the cursor.
  */
-struct StringSpannerFallback
+class MirroredBuffer
 {
-    uint8_t charset_[256];
+    char *p_;
+    size_t capacity_;
+    size_t mapped_;
+    size_t limit_;
 
-    StringSpannerFallback(char c1=0, char c2=0, char c3=0, char c4=0)
+    static size_t page_size()
     {
-        ::memset(charset_, 0, sizeof charset_);
-        charset_[(unsigned) c1] = 1;
-        charset_[(unsigned) c2] = 1;
-        charset_[(unsigned) c3] = 1;
-        charset_[(unsigned) c4] = 1;
-        charset_[0] = 1;
+        return (size_t) sysconf(_SC_PAGESIZE);
     }
 
-    size_t
-    operator()(const char *s)
-        __attribute__((__always_inline__))
+    bool map_mirrored()
     {
-        CSM_DEBUG("bitfield[32] = %d", charset_[32]);
-        CSM_DEBUG("span[0] = {%d,%d,%d,%d,%d,%d,%d,%d}",
-            s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]);
-        CSM_DEBUG("span[1] = {%d,%d,%d,%d,%d,%d,%d,%d}",
-            s[8], s[9], s[10], s[11], s[12], s[13], s[14], s[15]);
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        size_t page = page_size();
+        int fd = memfd_create("csvmonkey", MFD_CLOEXEC);
+        if(fd == -1) {
+            return false;
+        }
+        if(ftruncate(fd, capacity_) == -1) {
+            ::close(fd);
+            return false;
+        }
 
-        auto p = (const unsigned char *)s;
-        auto e = p + 16;
+        // Reserve the whole range, then replace it piecewise with MAP_FIXED,
+        // as in MappedFileCursor::open().
+        size_t size = (2 * capacity_) + page;
+        auto p = (char *) mmap(0, size, PROT_NONE,
+                               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        bool ok = p != MAP_FAILED;
+        for(size_t i = 0; ok && i < 3; i++) {
+            size_t len = (i == 2) ? page : capacity_;
+            char *want = p + (i * capacity_);
+            ok = want == mmap(want, len, PROT_READ|PROT_WRITE,
+                              MAP_SHARED|MAP_FIXED, fd, 0);
+        }
+        ::close(fd);
 
-        do {
-            if(charset_[p[0]]) {
-                break;
-            }
-            if(charset_[p[1]]) {
-                p++;
-                break;
-            }
-            if(charset_[p[2]]) {
-                p += 2;
-                break;
+        if(! ok) {
+            if(p != MAP_FAILED) {
+                munmap(p, size);
             }
-            if(charset_[p[3]]) {
-                p += 3;
-                break;
+            return false;
+        }
+        p_ = p;
+        mapped_ = size;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    public:
+    MirroredBuffer(size_t capacity)
+        : p_(0)
+        , mapped_(0)
+        , limit_(0)
+    {
+        size_t page = page_size();
+        capacity_ = std::max(page, (capacity + page - 1) & ~(page - 1));
+        if(! map_mirrored()) {
+            CSM_DEBUG("MirroredBuffer: using unmirrored fallback");
+            p_ = (char *) calloc(1, capacity_ + 32);
+            if(! p_) {
+                throw Error("calloc", "could not allocate buffer");
             }
-            p += 4;
-        } while(p < e);
+        }
+        limit_ = capacity_;
+    }
 
-        if(! *p) {
-            return 16; // PCMPISTRI reports NUL encountered as no match.
+    MirroredBuffer(const MirroredBuffer &) = delete;
+    MirroredBuffer &operator=(const MirroredBuffer &) = delete;
+
+    ~MirroredBuffer()
+    {
+        if(mapped_) {
+            munmap(p_, mapped_);
+        } else {
+            free(p_);
         }
+    }
 
-        return p - (const unsigned char *)s;
+    char &operator[](size_t i)
+    {
+        return p_[i];
     }
-};
 
-using StringSpanner = StringSpannerFallback;
-#   define CSM_ATTR_SSE42
-#endif // !CSM_USE_SSE42
+    size_t size() const
+    {
+        return limit_;
+    }
 
+    size_t capacity() const
+    {
+        return capacity_;
+    }
 
-#ifdef CSM_USE_SSE42
-struct alignas(16) StringSpannerSse42
-{
-    __m128i v_;
+    bool mirrored() const
+    {
+        return mapped_ != 0;
+    }
 
-    StringSpannerSse42(char c1=0, char c2=0, char c3=0, char c4=0)
+    void set_limit(size_t limit)
     {
-        assert(! ((reinterpret_cast<intptr_t>(&v_) & 15)));
-        __v16qi vq = {c1, c2, c3, c4};
-        v_ = (__m128i) vq;
+        limit_ = limit;
     }
 
-    size_t __attribute__((__always_inline__, target("sse4.2")))
-    operator()(const char *buf)
+    void swap(MirroredBuffer &other)
     {
-        return _mm_cmpistri(
-            v_,
-            _mm_loadu_si128((__m128i *) buf),
-            0
-        );
+        std::swap(p_, other.p_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(mapped_, other.mapped_);
+        std::swap(limit_, other.limit_);
     }
 };
 
-using StringSpanner = StringSpannerSse42;
-#   define CSM_ATTR_SSE42 __attribute__((target("sse4.2")))
-#endif // CSM_USE_SSE42
-
 
-class CsvCursor
+class BufferedStreamCursor
+    : public StreamCursor
 {
+    protected:
+    MirroredBuffer vec_;
+    size_t read_pos_;
+    size_t write_pos_;
+
+    virtual ssize_t readmore() = 0;
+
+    BufferedStreamCursor()
+        : vec_(131072)
+        , read_pos_(0)
+        , write_pos_(0)
+    {
+    }
+
+    protected:
+    /**
+     * Update vec_.size() to reflect the space following write_pos_ that does
+     * not overlap unconsumed input.
+     */
+    void update_limit()
+    {
+        vec_.set_limit(vec_.mirrored()
+            ? (read_pos_ + vec_.capacity())
+            : vec_.capacity());
+    }
+
+    void ensure(size_t capacity)
+    {
+        size_t available = vec_.size() - write_pos_;
+        if(available < capacity) {
+            // Doubling keeps growth due to very long rows infrequent.
+            size_t n = write_pos_ - read_pos_;
+            MirroredBuffer vec(std::max(2 * vec_.capacity(), n + capacity));
+            CSM_DEBUG("resizing vec_ %lu", (size_t) vec.capacity());
+            memcpy(&vec[0], &vec_[read_pos_], n);
+            vec_.swap(vec);
+            read_pos_ = 0;
+            write_pos_ = n;
+            update_limit();
+        }
+    }
+
     public:
-    std::vector<CsvCell> cells;
-    size_t count;
+    const char *buf()
+    {
+        return &vec_[0] + read_pos_;
+    }
 
-    CsvCursor()
-        : cells()
-        , count(0)
+    size_t size()
     {
+        return write_pos_ - read_pos_;
     }
 
-    bool
-    by_value(const std::string &value, CsvCell *&cell)
+    void consume(size_t n)
     {
-        for(size_t i = 0; i < count; i++) {
-            if(value == cells[i].as_str()) {
-                cell = &cells[i];
-                return true;
+        read_pos_ += std::min(n, write_pos_ - read_pos_);
+        CSM_DEBUG("consume(%lu); new size: %lu", n, size())
+    }
+
+    virtual bool fill()
+    {
+        if(vec_.mirrored()) {
+            // The tail is already in place, its offset just needs wrapping.
+            if(read_pos_ >= vec_.capacity()) {
+                read_pos_ -= vec_.capacity();
+                write_pos_ -= vec_.capacity();
             }
+        } else if(read_pos_) {
+            size_t n = write_pos_ - read_pos_;
+            CSM_DEBUG("read_pos_ needs adjust, it is %lu / n = %lu", read_pos_, n);
+            memmove(&vec_[0], &vec_[read_pos_], n);
+            CSM_DEBUG("fill() adjust old write_pos = %lu", write_pos_);
+            write_pos_ -= read_pos_;
+            read_pos_ = 0;
+            CSM_DEBUG("fill() adjust new write_pos = %lu", write_pos_);
         }
-        return false;
+
+        update_limit();
+        if(write_pos_ == vec_.size()) {
+            ensure(vec_.capacity() / 2);
+        }
+
+        ssize_t rc = readmore();
+        if(rc <= 0) {
+            CSM_DEBUG("readmore() failed or reached EOF");
+            return false;
+        }
+
+        CSM_DEBUG("readmore() succeeded")
+        CSM_DEBUG("fill() old write_pos = %lu", write_pos_);
+        write_pos_ += rc;
+        CSM_DEBUG("fill() new write_pos = %lu", write_pos_);
+        return true;
     }
 };
 
 
-template<class StreamCursorType>
-class alignas(16) CsvReader
+class FdStreamCursor
+    : public BufferedStreamCursor
 {
-    const char *endp_;
-    const char *p_;
-    char delimiter_;
-    char quotechar_;
-    char escapechar_;
-    bool yield_incomplete_row_;
+    int fd_;
 
     public:
-    bool in_newline_skip;
-
-    private:
-    StreamCursorType &stream_;
-    StringSpanner quoted_cell_spanner_;
-    StringSpanner unquoted_cell_spanner_;
-    CsvCursor row_;
-
-    enum CsmTryParseReturnType {
-        kCsmTryParseOkay,
-        kCsmTryParseOverflow,
-        kCsmTryParseUnderrun
-    };
+    FdStreamCursor(int fd)
+        : BufferedStreamCursor()
+        , fd_(fd)
+    {
+    }
 
-    CsmTryParseReturnType
-    try_parse()
-        CSM_ATTR_SSE42
+    virtual ssize_t readmore()
     {
-        const char *p = p_;
-        const char *cell_start;
-        int rc, rc2;
+        return ::read(fd_, &vec_[write_pos_], vec_.size() - write_pos_);
+    }
+};
 
-        CsvCell *cell = &row_.cells[0];
-        row_.count = 0;
 
-        #define PREAMBLE() \
-            if(p >= endp_) {\
-                CSM_DEBUG("pos exceeds size"); \
-                return kCsmTryParseUnderrun; \
-            } \
-            CSM_DEBUG("p = %#p; remain = %ld; next char is: %d", p, endp_-p, (int)*p) \
-            CSM_DEBUG("%d: distance to next newline: %d", __LINE__, strchr(p, '\n') - p);
+/**
+ * Stream a file with O_DIRECT, bypassing the page cache so that one-shot scans
+ * of huge files do not evict the working sets of other processes. Reads of
+ * `block_size` bytes land in a page-aligned buffer: before each read, the
+ * unconsumed tail is moved to end just below an aligned boundary, and the new
+ * data is read from there. On Darwin, F_NOCACHE is used instead. Where the
+ * filesystem refuses O_DIRECT, or neither is available, the file is read
+ * normally, and each range is dropped from the cache using
+ * POSIX_FADV_DONTNEED once it has been copied into the buffer.
+ */
+class ODirectStreamCursor
+    : public StreamCursor
+{
+    int fd_;
+    bool direct_;
+    size_t align_;
+    size_t block_size_;
+    char *base_;
+    size_t capacity_;
+    char *p_;
+    char *endp_;
+    uint64_t offset_;
+    bool eof_;
 
-        #define NEXT_CELL() \
-            ++cell; \
-            if(row_.count == row_.cells.size()) { \
-                CSM_DEBUG("cell array overflow"); \
-                return kCsmTryParseOverflow; \
-            }
+    char *allocate(size_t capacity)
+    {
+        void *p;
+        // Room for the trailing NULs following a full buffer.
+        if(posix_memalign(&p, align_, capacity + align_)) {
+            throw Error("posix_memalign", "could not allocate buffer");
+        }
+        return (char *) p;
+    }
 
-        CSM_DEBUG("remain = %lu", endp_ - p);
-        CSM_DEBUG("ch = %d %c", (int) *p, *p);
+    void drop_cache(uint64_t offset, uint64_t len)
+    {
+#ifdef POSIX_FADV_DONTNEED
+        if(! direct_) {
+            posix_fadvise(fd_, offset, len, POSIX_FADV_DONTNEED);
+        }
+#endif
+    }
 
-    newline_skip:
-        /*
-         * Skip newlines appearing at the start of the line, which may be a
-         * result of DOS/MAC-formatted input. Or a double-spaced CSV file.
-         */
-        in_newline_skip = true;
-        PREAMBLE()
-        if(*p == '\r' || *p == '\n') {
-            ++p;
-            goto newline_skip;
+    /**
+     * Close any open file, and discard buffered input.
+     */
+    void close_file()
+    {
+        if(fd_ != -1) {
+            drop_cache(0, 0);
+            ::close(fd_);
+            fd_ = -1;
         }
+        direct_ = false;
+        p_ = endp_ = base_;
+        memset(base_, 0, 32);
+        offset_ = 0;
+        eof_ = false;
+    }
 
-    cell_start:
-        in_newline_skip = false;
-        PREAMBLE()
-        cell->escaped = false;
-        if(*p == '\r' || *p == '\n') {
-            /*
-             * A newline appearing after at least one cell has been read
-             * indicates the presence of a single comma demarcating an unquoted
-             * unquoted unquoted unquoted empty final field.
-             */
-            cell->ptr = 0;
-            cell->size = 0;
-            ++row_.count;
-            p_ = p + 1;
-            return kCsmTryParseOkay;
-        } else if(*p == quotechar_) {
-            cell_start = ++p;
-            goto in_quoted_cell;
+    public:
+    ODirectStreamCursor(size_t block_size=1 << 20)
+        : fd_(-1)
+        , direct_(false)
+        , base_(0)
+        , p_(0)
+        , endp_(0)
+        , offset_(0)
+        , eof_(false)
+    {
+        align_ = (size_t) sysconf(_SC_PAGESIZE);
+        block_size_ = std::max(align_, (block_size + align_ - 1) & ~(align_ - 1));
+        capacity_ = 2 * block_size_;
+        base_ = allocate(capacity_);
+        close_file();
+    }
+
+    ~ODirectStreamCursor()
+    {
+        close_file();
+        free(base_);
+    }
+
+    /**
+     * Open `filename`, replacing any file previously opened. Throws Error on
+     * failure.
+     */
+    void open(const char *filename)
+    {
+        close_file();
+#ifdef O_DIRECT
+        fd_ = ::open(filename, O_RDONLY|O_DIRECT);
+        direct_ = fd_ != -1;
+        if(fd_ == -1 && errno == EINVAL) {
+            CSM_DEBUG("O_DIRECT unsupported for %s, using fadvise", filename);
+            fd_ = ::open(filename, O_RDONLY);
+        }
+#else
+        fd_ = ::open(filename, O_RDONLY);
+#endif
+        if(fd_ == -1) {
+            throw Error(filename, strerror(errno));
+        }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        direct_ = fcntl(fd_, F_NOCACHE, 1) != -1;
+#endif
+#ifdef POSIX_FADV_SEQUENTIAL
+        if(! direct_) {
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    /**
+     * Return true if the file was opened with O_DIRECT or F_NOCACHE, or false
+     * if the page cache is dropped behind the cursor instead.
+     */
+    bool direct() const
+    {
+        return direct_;
+    }
+
+    const char *buf()
+    {
+        return p_;
+    }
+
+    size_t size()
+    {
+        return endp_ - p_;
+    }
+
+    void consume(size_t n)
+    {
+        p_ += std::min(n, (size_t) (endp_ - p_));
+    }
+
+    bool fill()
+    {
+        if(eof_ || fd_ == -1) {
+            return false;
+        }
+
+        size_t n = endp_ - p_;
+        size_t head = (n + align_ - 1) & ~(align_ - 1);
+        if(head + block_size_ > capacity_) {
+            size_t capacity = std::max(2 * capacity_, head + block_size_);
+            char *base = allocate(capacity);
+            memcpy(base + head - n, p_, n);
+            free(base_);
+            base_ = base;
+            capacity_ = capacity;
         } else {
-            cell_start = p;
-            goto in_unquoted_cell;
+            memmove(base_ + head - n, p_, n);
+        }
+        p_ = base_ + head - n;
+        endp_ = base_ + head;
+
+        ssize_t rc;
+        do {
+            rc = ::pread(fd_, endp_, block_size_, offset_);
+        } while(rc == -1 && errno == EINTR);
+        if(rc == -1) {
+            throw Error("pread", strerror(errno));
+        }
+
+        drop_cache(offset_, rc);
+        offset_ += rc;
+        endp_ += rc;
+        memset(endp_, 0, 32);
+        // A short read means EOF, and a further O_DIRECT read from the
+        // resulting unaligned offset would fail regardless.
+        eof_ = (size_t) rc < block_size_;
+        return rc > 0;
+    }
+};
+
+
+#ifdef USE_ZLIB
+/**
+ * Buffered input from a gzip or zlib compressed UNIX file descriptor,
+ * inflating directly into the cursor's buffer. Concatenated gzip members, as
+ * written by `cat a.gz b.gz` or pigz, are read in sequence. To run
+ * decompression on its own thread, wrap the cursor in a ReadAheadStreamCursor.
+ */
+class GzipStreamCursor
+    : public BufferedStreamCursor
+{
+    int fd_;
+    z_stream zs_;
+    std::vector<unsigned char> in_;
+    /// Input has been fed to the current member, which has not yet ended.
+    bool in_member_;
+    bool eof_;
+
+    bool read_input()
+    {
+        ssize_t rc;
+        do {
+            rc = ::read(fd_, in_.data(), in_.size());
+        } while(rc == -1 && errno == EINTR);
+        if(rc == -1) {
+            throw Error("read", strerror(errno));
+        }
+        zs_.next_in = in_.data();
+        zs_.avail_in = (uInt) rc;
+        return rc > 0;
+    }
+
+    public:
+    GzipStreamCursor(int fd, size_t input_size=65536)
+        : BufferedStreamCursor()
+        , fd_(fd)
+        , in_(std::max(input_size, (size_t) 1))
+        , in_member_(false)
+        , eof_(false)
+    {
+        memset(&zs_, 0, sizeof zs_);
+        // 15 window bits, +32 to detect gzip or zlib headers.
+        if(inflateInit2(&zs_, 15 + 32) != Z_OK) {
+            throw Error("zlib", zs_.msg ? zs_.msg : "inflateInit2 failed");
+        }
+    }
+
+    ~GzipStreamCursor()
+    {
+        inflateEnd(&zs_);
+    }
+
+    virtual ssize_t readmore()
+    {
+        auto avail = (uInt) std::min(vec_.size() - write_pos_, (size_t) 1 << 30);
+        zs_.next_out = (Bytef *) &vec_[write_pos_];
+        zs_.avail_out = avail;
+
+        while(zs_.avail_out == avail && ! eof_) {
+            if(! (zs_.avail_in || read_input())) {
+                if(in_member_) {
+                    throw Error("zlib", "unexpected end of compressed input");
+                }
+                eof_ = true;
+                break;
+            }
+
+            in_member_ = true;
+            int rc = inflate(&zs_, Z_NO_FLUSH);
+            if(rc == Z_STREAM_END) {
+                in_member_ = false;
+                inflateReset(&zs_);
+            } else if(rc != Z_OK && rc != Z_BUF_ERROR) {
+                throw Error("zlib", zs_.msg ? zs_.msg : "inflate failed");
+            }
+        }
+        return avail - zs_.avail_out;
+    }
+};
+#endif // USE_ZLIB
+
+
+#ifdef USE_ZSTD
+/**
+ * Buffered input from a zstd compressed UNIX file descriptor.
+ *
+ * With one thread, input is decompressed directly into the cursor's buffer.
+ * With more, complete frames are located in the compressed input and
+ * decompressed by a pool of worker threads, keeping up to two frames per
+ * thread, and at most `max_buffered` decompressed bytes, in flight ahead of
+ * the parser, and copied out in order. A frame whose output would not fit is
+ * instead decompressed from its compressed bytes on the parser's thread. This
+ * suits
+ * multi-frame files written by pzstd, `zstd --rsyncable` of concatenated
+ * inputs, or the seekable format, whose seek table is a skippable frame.
+ * Should a single frame exceed `max_frame_size` compressed bytes, as with
+ * ordinary single-frame files, the remainder of the input is streamed
+ * instead. Streaming can still be moved off the parser's thread by wrapping
+ * the cursor in a ReadAheadStreamCursor.
+ */
+class ZstdStreamCursor
+    : public BufferedStreamCursor
+{
+    struct Frame
+    {
+        std::vector<char> in;
+        std::vector<char> out;
+        /// Bytes of `out` already copied, or of `in` consumed if streamed.
+        size_t pos;
+        /// Largest output a worker may produce, counted against buffered_.
+        size_t limit;
+        const char *error;
+        bool done;
+        /// Output exceeds `limit`, so readmore() streams `in` instead.
+        bool overflow;
+    };
+
+    int fd_;
+    size_t threads_;
+    size_t max_frame_size_;
+    size_t max_buffered_;
+    /// Sum of the limits of frames in frames_.
+    size_t buffered_;
+    ZSTD_DCtx *dctx_;
+    std::vector<char> in_;
+    size_t in_pos_;
+    size_t in_end_;
+    bool in_eof_;
+    /// Decompressing on this thread, rather than by frame.
+    bool streaming_;
+    /// Streaming: the current frame has not yet been fully decoded.
+    bool in_frame_;
+
+    std::deque<std::shared_ptr<Frame>> frames_;
+    std::deque<std::shared_ptr<Frame>> queue_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_;
+
+    /**
+     * Append compressed input to in_, returning false at EOF.
+     */
+    bool read_input()
+    {
+        if(in_pos_ == in_end_) {
+            in_pos_ = in_end_ = 0;
+        }
+        if(in_end_ == in_.size()) {
+            if(in_pos_) {
+                memmove(&in_[0], &in_[in_pos_], in_end_ - in_pos_);
+                in_end_ -= in_pos_;
+                in_pos_ = 0;
+            } else {
+                in_.resize(2 * in_.size());
+            }
+        }
+
+        ssize_t rc;
+        do {
+            rc = ::read(fd_, &in_[in_end_], in_.size() - in_end_);
+        } while(rc == -1 && errno == EINTR);
+        if(rc == -1) {
+            throw Error("read", strerror(errno));
+        }
+        in_eof_ = rc == 0;
+        in_end_ += rc;
+        return rc > 0;
+    }
+
+    /**
+     * Queue the next complete frame for a worker, returning false at EOF, on
+     * switching to streaming because the frame is too large, or if its output
+     * would exceed max_buffered_ while other frames are in flight.
+     */
+    bool dispatch()
+    {
+        for(;;) {
+            size_t avail = in_end_ - in_pos_;
+            if(avail) {
+                size_t size = ZSTD_findFrameCompressedSize(&in_[in_pos_], avail);
+                if(! ZSTD_isError(size)) {
+                    // Frames of unknown size get an even share of the budget.
+                    unsigned long long content =
+                        ZSTD_getFrameContentSize(&in_[in_pos_], size);
+                    size_t limit = std::max(max_buffered_ / (2 * threads_),
+                                            (size_t) 1);
+                    bool overflow = false;
+                    if(content == ZSTD_CONTENTSIZE_UNKNOWN ||
+                            content == ZSTD_CONTENTSIZE_ERROR) {
+                    } else if(content > max_buffered_) {
+                        overflow = true;
+                        limit = 0;
+                    } else {
+                        limit = content;
+                    }
+                    if(frames_.size() && buffered_ + limit > max_buffered_) {
+                        return false;
+                    }
+
+                    auto frame = std::make_shared<Frame>();
+                    frame->in.assign(&in_[in_pos_], &in_[in_pos_] + size);
+                    frame->pos = 0;
+                    frame->limit = limit;
+                    frame->error = 0;
+                    frame->done = overflow;
+                    frame->overflow = overflow;
+                    in_pos_ += size;
+                    buffered_ += limit;
+
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    frames_.push_back(frame);
+                    if(! overflow) {
+                        queue_.push_back(frame);
+                        cond_.notify_all();
+                    }
+                    return true;
+                } else if(ZSTD_getErrorCode(size) != ZSTD_error_srcSize_wrong) {
+                    throw Error("zstd", ZSTD_getErrorName(size));
+                }
+            }
+
+            if(avail >= max_frame_size_) {
+                CSM_DEBUG("zstd frame exceeds %lu bytes, streaming", max_frame_size_);
+                streaming_ = true;
+                return false;
+            }
+            if(! read_input()) {
+                if(avail) {
+                    throw Error("zstd", "unexpected end of compressed input");
+                }
+                return false;
+            }
+        }
+    }
+
+    static void decompress(ZSTD_DCtx *dctx, Frame &frame)
+    {
+        unsigned long long size = ZSTD_getFrameContentSize(frame.in.data(),
+                                                           frame.in.size());
+        if(size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR
+                || size > frame.limit) {
+            size = std::min(ZSTD_DStreamOutSize(), frame.limit);
+        }
+        frame.out.resize(std::max(size, 1ULL));
+
+        ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+        ZSTD_inBuffer in = { frame.in.data(), frame.in.size(), 0 };
+        ZSTD_outBuffer out = { frame.out.data(), frame.out.size(), 0 };
+        for(;;) {
+            size_t rc = ZSTD_decompressStream(dctx, &out, &in);
+            if(ZSTD_isError(rc)) {
+                frame.error = ZSTD_getErrorName(rc);
+                break;
+            } else if(! rc) {
+                break;
+            } else if(out.pos == out.size) {
+                if(frame.out.size() >= frame.limit) {
+                    frame.overflow = true;
+                    std::vector<char>().swap(frame.out);
+                    return;
+                }
+                frame.out.resize(std::min(2 * frame.out.size(), frame.limit));
+                out.dst = frame.out.data();
+                out.size = frame.out.size();
+            } else if(in.pos == in.size) {
+                frame.error = "truncated frame";
+                break;
+            }
+        }
+        frame.out.resize(out.pos);
+    }
+
+    void work()
+    {
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        std::unique_lock<std::mutex> lock(mutex_);
+        for(;;) {
+            cond_.wait(lock, [&] { return stop_ || queue_.size(); });
+            if(stop_) {
+                break;
+            }
+
+            auto frame = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+            if(dctx) {
+                decompress(dctx, *frame);
+            } else {
+                frame->error = "ZSTD_createDCtx failed";
+            }
+            lock.lock();
+            frame->done = true;
+            cond_.notify_all();
+        }
+        ZSTD_freeDCtx(dctx);
+    }
+
+    /**
+     * Decompress an overflowed frame directly into vec_, setting `finished`
+     * once its output is complete.
+     */
+    ssize_t stream_frame(Frame &frame, bool &finished)
+    {
+        if(! frame.pos) {
+            ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
+        }
+        ZSTD_inBuffer in = { frame.in.data(), frame.in.size(), frame.pos };
+        ZSTD_outBuffer out = { &vec_[write_pos_], vec_.size() - write_pos_, 0 };
+        size_t rc = ZSTD_decompressStream(dctx_, &out, &in);
+        if(ZSTD_isError(rc)) {
+            throw Error("zstd", ZSTD_getErrorName(rc));
+        } else if(rc && in.pos == in.size && out.pos < out.size) {
+            throw Error("zstd", "truncated frame");
+        }
+        frame.pos = in.pos;
+        finished = ! rc;
+        return out.pos;
+    }
+
+    ssize_t stream()
+    {
+        ZSTD_outBuffer out = { &vec_[write_pos_], vec_.size() - write_pos_, 0 };
+        while(! out.pos) {
+            if(in_pos_ == in_end_ && ! read_input()) {
+                if(in_frame_) {
+                    throw Error("zstd", "unexpected end of compressed input");
+                }
+                return 0;
+            }
+
+            ZSTD_inBuffer in = { &in_[in_pos_], in_end_ - in_pos_, 0 };
+            size_t rc = ZSTD_decompressStream(dctx_, &out, &in);
+            if(ZSTD_isError(rc)) {
+                throw Error("zstd", ZSTD_getErrorName(rc));
+            }
+            in_pos_ += in.pos;
+            in_frame_ = rc != 0;
+        }
+        return out.pos;
+    }
+
+    public:
+    ZstdStreamCursor(int fd, size_t threads=1, size_t max_frame_size=4 << 20,
+                     size_t max_buffered=64 << 20)
+        : BufferedStreamCursor()
+        , fd_(fd)
+        , threads_(std::max(threads, (size_t) 1))
+        , max_frame_size_(max_frame_size)
+        , max_buffered_(max_buffered)
+        , buffered_(0)
+        , dctx_(ZSTD_createDCtx())
+        , in_(ZSTD_DStreamInSize())
+        , in_pos_(0)
+        , in_end_(0)
+        , in_eof_(false)
+        , streaming_(threads_ == 1)
+        , in_frame_(false)
+        , stop_(false)
+    {
+        if(! dctx_) {
+            throw Error("zstd", "ZSTD_createDCtx failed");
+        }
+        if(! streaming_) {
+            for(size_t i = 0; i < threads_; i++) {
+                workers_.emplace_back(&ZstdStreamCursor::work, this);
+            }
+        }
+    }
+
+    ~ZstdStreamCursor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            cond_.notify_all();
+        }
+        for(auto &worker : workers_) {
+            worker.join();
+        }
+        ZSTD_freeDCtx(dctx_);
+    }
+
+    virtual ssize_t readmore()
+    {
+        for(;;) {
+            while(! streaming_ && frames_.size() < (2 * threads_) && dispatch()) {
+            }
+            if(frames_.empty()) {
+                return streaming_ ? stream() : 0;
+            }
+
+            std::shared_ptr<Frame> frame = frames_.front();
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&] { return frame->done; });
+            }
+            if(frame->error) {
+                throw Error("zstd", frame->error);
+            }
+            if(! frame->overflow && frame->limit > frame->out.size()) {
+                // Release the budget a worker did not use.
+                buffered_ -= frame->limit - frame->out.size();
+                frame->limit = frame->out.size();
+            }
+
+            size_t n;
+            bool finished;
+            if(frame->overflow) {
+                n = stream_frame(*frame, finished);
+            } else {
+                n = std::min(frame->out.size() - frame->pos,
+                             vec_.size() - write_pos_);
+                memcpy(&vec_[write_pos_], frame->out.data() + frame->pos, n);
+                frame->pos += n;
+                finished = frame->pos == frame->out.size();
+            }
+            if(finished) {
+                buffered_ -= frame->limit;
+                frames_.pop_front();
+            }
+            if(n) {
+                return n;
+            }
+        }
+    }
+};
+#endif // USE_ZSTD
+
+
+#ifdef CSM_USE_IO_URING
+/**
+ * Minimal io_uring submission and completion queue pair, driven by raw system
+ * calls. Not thread safe.
+ */
+class IoUring
+{
+    int fd_;
+    char *sq_ptr_;
+    size_t sq_len_;
+    char *cq_ptr_;
+    size_t cq_len_;
+    struct io_uring_sqe *sqes_;
+    size_t sqes_len_;
+
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_pending_tail_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe *cqes_;
+
+    void *map(size_t size, uint64_t offset)
+    {
+        int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void *p = mmap(0, size, PROT_READ|PROT_WRITE, flags, fd_, offset);
+        return (p == MAP_FAILED) ? 0 : p;
+    }
+
+    /**
+     * IORING_OP_READ appeared in Linux 5.6, alongside IORING_REGISTER_PROBE.
+     */
+    bool supports_read()
+    {
+        std::vector<char> buf(sizeof(io_uring_probe) +
+                              256 * sizeof(io_uring_probe_op));
+        auto probe = (io_uring_probe *) &buf[0];
+        if(syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE,
+                   probe, 256) == -1) {
+            return false;
+        }
+        return probe->last_op >= IORING_OP_READ
+            && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    public:
+    IoUring()
+        : fd_(-1)
+        , sq_ptr_(0)
+        , cq_ptr_(0)
+        , sqes_(0)
+    {
+    }
+
+    ~IoUring()
+    {
+        close();
+    }
+
+    /**
+     * Create a ring with at least `entries` submission slots. Return false if
+     * io_uring is unavailable, e.g. due to an old kernel or seccomp policy.
+     */
+    bool open(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof params);
+        fd_ = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if(fd_ == -1) {
+            CSM_DEBUG("io_uring_setup failed: %s", strerror(errno));
+            return false;
+        }
+
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len_ = params.cq_off.cqes
+                + params.cq_entries * sizeof(io_uring_cqe);
+        if(single) {
+            sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+        }
+        sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+
+        sq_ptr_ = (char *) map(sq_len_, IORING_OFF_SQ_RING);
+        cq_ptr_ = single ? sq_ptr_ : (char *) map(cq_len_, IORING_OFF_CQ_RING);
+        sqes_ = (io_uring_sqe *) map(sqes_len_, IORING_OFF_SQES);
+        if(! (sq_ptr_ && cq_ptr_ && sqes_ && supports_read())) {
+            close();
+            return false;
+        }
+
+        sq_head_ = (unsigned *) (sq_ptr_ + params.sq_off.head);
+        sq_tail_ = (unsigned *) (sq_ptr_ + params.sq_off.tail);
+        sq_array_ = (unsigned *) (sq_ptr_ + params.sq_off.array);
+        sq_mask_ = *(unsigned *) (sq_ptr_ + params.sq_off.ring_mask);
+        sq_pending_tail_ = *sq_tail_;
+        cq_head_ = (unsigned *) (cq_ptr_ + params.cq_off.head);
+        cq_tail_ = (unsigned *) (cq_ptr_ + params.cq_off.tail);
+        cq_mask_ = *(unsigned *) (cq_ptr_ + params.cq_off.ring_mask);
+        cqes_ = (io_uring_cqe *) (cq_ptr_ + params.cq_off.cqes);
+        return true;
+    }
+
+    void close()
+    {
+        if(sqes_) {
+            munmap(sqes_, sqes_len_);
+        }
+        if(cq_ptr_ && cq_ptr_ != sq_ptr_) {
+            munmap(cq_ptr_, cq_len_);
         }
+        if(sq_ptr_) {
+            munmap(sq_ptr_, sq_len_);
+        }
+        if(fd_ != -1) {
+            ::close(fd_);
+        }
+        fd_ = -1;
+        sq_ptr_ = cq_ptr_ = 0;
+        sqes_ = 0;
+    }
+
+    /**
+     * Return a zeroed submission entry, which is not visible to the kernel
+     * until the next enter(). Throws Error if the submission queue is full.
+     */
+    io_uring_sqe *get_sqe()
+    {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if((sq_pending_tail_ - head) > sq_mask_) {
+            throw Error("io_uring", "submission queue full");
+        }
+
+        unsigned index = sq_pending_tail_++ & sq_mask_;
+        sq_array_[index] = index;
+        memset(&sqes_[index], 0, sizeof sqes_[index]);
+        return &sqes_[index];
+    }
+
+    /**
+     * Submit any pending entries, then wait for at least `wait_nr`
+     * completions.
+     */
+    void enter(unsigned wait_nr)
+    {
+        __atomic_store_n(sq_tail_, sq_pending_tail_, __ATOMIC_RELEASE);
+        for(;;) {
+            unsigned submit = sq_pending_tail_
+                            - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            if(! (submit || wait_nr)) {
+                return;
+            }
+
+            long rc = syscall(__NR_io_uring_enter, fd_, submit, wait_nr,
+                              wait_nr ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+            if(rc != -1) {
+                return;
+            } else if(errno != EINTR) {
+                throw Error("io_uring_enter", strerror(errno));
+            }
+        }
+    }
+
+    /**
+     * Invoke `fn(user_data, res)` for each available completion.
+     */
+    template<class Fn>
+    void reap(Fn fn)
+    {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++) {
+            const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+            fn(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+};
+#endif // CSM_USE_IO_URING
+
+
+/**
+ * Buffered input from a UNIX file descriptor that keeps several fixed-size
+ * reads in flight ahead of the parser, so input from slow pipes or O_DIRECT
+ * volumes is usually already in memory by the time fill() is called. Reads
+ * are queued using io_uring where the kernel supports it, otherwise a
+ * background thread performs them.
+ *
+ * Regular files and block devices are read at explicit offsets starting from
+ * the descriptor's current position, with `depth` reads outstanding; the
+ * descriptor's file position is not updated. Pipes and sockets have no
+ * offsets, so only one io_uring read is outstanding for them at a time.
+ * Buffers are page aligned, and `block_size` is rounded up to a multiple of
+ * the page size, satisfying O_DIRECT.
+ */
+class IoUringStreamCursor
+    : public BufferedStreamCursor
+{
+    struct Slot
+    {
+        char *buf;
+        uint64_t offset;
+        size_t filled;
+        int error;
+        bool eof;
+        bool done;
+    };
+
+    int fd_;
+    size_t block_size_;
+    bool seekable_;
+    uint64_t next_offset_;
+    char *bufs_;
+    std::vector<Slot> slots_;
+    size_t head_;
+    bool eof_;
+    bool uring_;
+    bool stop_;
+
+#ifdef CSM_USE_IO_URING
+    IoUring ring_;
+    size_t inflight_;
+#endif
+
+    // Thread fallback. Slots whose done flag is clear belong to the thread.
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    int wake_[2];
+
+    void queue(Slot &slot)
+    {
+        slot.offset = next_offset_;
+        next_offset_ += block_size_;
+        slot.filled = 0;
+        slot.error = 0;
+        slot.eof = false;
+
+#ifdef CSM_USE_IO_URING
+        if(uring_) {
+            slot.done = false;
+            submit(slot);
+            return;
+        }
+#endif
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot.done = false;
+        cond_.notify_all();
+    }
+
+    Slot &wait(Slot &slot)
+    {
+#ifdef CSM_USE_IO_URING
+        if(uring_) {
+            for(;;) {
+                reap();
+                if(slot.done) {
+                    return slot;
+                }
+                ring_.enter(1);
+            }
+        }
+#endif
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return slot.done; });
+        return slot;
+    }
+
+#ifdef CSM_USE_IO_URING
+    void submit(Slot &slot)
+    {
+        io_uring_sqe *sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd_;
+        sqe->addr = (uint64_t) (uintptr_t) (slot.buf + slot.filled);
+        sqe->len = (unsigned) (block_size_ - slot.filled);
+        sqe->off = seekable_ ? (slot.offset + slot.filled) : (uint64_t) -1;
+        sqe->user_data = &slot - &slots_[0];
+        inflight_++;
+    }
+
+    void reap()
+    {
+        ring_.reap([&](uint64_t user_data, int res) {
+            if(user_data >= slots_.size()) {
+                return; // IORING_OP_ASYNC_CANCEL
+            }
+
+            Slot &slot = slots_[user_data];
+            inflight_--;
+            if((res == -EINTR || res == -EAGAIN) && ! stop_) {
+                submit(slot);
+                return;
+            } else if(res < 0) {
+                slot.error = -res;
+            } else if(res == 0) {
+                slot.eof = true;
+            } else {
+                slot.filled += res;
+                // Fill regular file blocks completely, since the following
+                // block's read has already been issued.
+                if(seekable_ && slot.filled < block_size_ && ! stop_) {
+                    submit(slot);
+                    return;
+                }
+            }
+            slot.done = true;
+        });
+    }
+#endif // CSM_USE_IO_URING
+
+    /**
+     * Thread fallback: wait for `fd_` to become readable, or for the
+     * destructor to signal the wakeup pipe. Return false in the latter case.
+     */
+    bool wait_readable()
+    {
+        struct pollfd fds[2];
+        fds[0].fd = fd_;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_[0];
+        fds[1].events = POLLIN;
+        while(::poll(fds, 2, -1) == -1) {
+            if(errno != EINTR) {
+                return true; // Let read() report the problem.
+            }
+        }
+        return ! fds[1].revents;
+    }
+
+    /**
+     * Thread fallback: complete one slot. Return false on EOF, error, or
+     * cancellation.
+     */
+    bool read_slot(Slot &slot)
+    {
+        while(slot.filled < block_size_) {
+            ssize_t rc;
+            if(seekable_) {
+                rc = ::pread(fd_, slot.buf + slot.filled,
+                             block_size_ - slot.filled,
+                             slot.offset + slot.filled);
+            } else if(! wait_readable()) {
+                return false;
+            } else {
+                rc = ::read(fd_, slot.buf, block_size_);
+            }
+
+            if(rc == -1) {
+                if(errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                slot.error = errno;
+                return false;
+            } else if(rc == 0) {
+                slot.eof = true;
+                return false;
+            }
+
+            slot.filled += rc;
+            if(! seekable_) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    void run()
+    {
+        for(size_t i = 0;; i = (i + 1) % slots_.size()) {
+            Slot &slot = slots_[i];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&] { return stop_ || ! slot.done; });
+                if(stop_) {
+                    return;
+                }
+            }
+
+            bool more = read_slot(slot);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slot.done = true;
+                cond_.notify_all();
+            }
+            if(! more) {
+                return;
+            }
+        }
+    }
+
+    public:
+    IoUringStreamCursor(int fd, size_t depth=4, size_t block_size=131072,
+                        bool use_io_uring=true)
+        : BufferedStreamCursor()
+        , fd_(fd)
+        , next_offset_(0)
+        , bufs_(0)
+        , head_(0)
+        , eof_(false)
+        , uring_(false)
+        , stop_(false)
+    {
+        wake_[0] = wake_[1] = -1;
+
+        struct stat st;
+        if(fstat(fd, &st) == -1) {
+            throw Error("fstat", strerror(errno));
+        }
+        seekable_ = S_ISREG(st.st_mode) || S_ISBLK(st.st_mode);
+        if(seekable_) {
+            off_t pos = ::lseek(fd, 0, SEEK_CUR);
+            next_offset_ = (pos == -1) ? 0 : pos;
+        }
+
+        size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+        depth = std::max(depth, (size_t) 1);
+        block_size_ = std::max(block_size, (size_t) 1);
+        block_size_ = (block_size_ + page_size - 1) & ~(page_size - 1);
+
+#ifdef CSM_USE_IO_URING
+        inflight_ = 0;
+        uring_ = use_io_uring && ring_.open((unsigned) depth);
+        if(uring_ && ! seekable_) {
+            depth = 1;
+        }
+#endif
+
+        if(posix_memalign((void **) &bufs_, page_size, depth * block_size_)) {
+            throw Error("posix_memalign", "could not allocate read buffers");
+        }
+
+        slots_.resize(depth);
+        for(size_t i = 0; i < depth; i++) {
+            slots_[i].buf = bufs_ + (i * block_size_);
+            slots_[i].done = true;
+        }
+
+        if(! uring_) {
+            CSM_DEBUG("io_uring unavailable, using reader thread");
+            if(::pipe(wake_) == -1) {
+                free(bufs_);
+                throw Error("pipe", strerror(errno));
+            }
+            thread_ = std::thread(&IoUringStreamCursor::run, this);
+        }
+
+        for(auto &slot : slots_) {
+            queue(slot);
+        }
+#ifdef CSM_USE_IO_URING
+        if(uring_) {
+            ring_.enter(0);
+        }
+#endif
+    }
+
+    ~IoUringStreamCursor()
+    {
+#ifdef CSM_USE_IO_URING
+        if(uring_) {
+            // Reads may still target the buffers, so cancel and wait for them
+            // all before freeing anything.
+            stop_ = true;
+            for(size_t i = 0; i < slots_.size(); i++) {
+                if(! slots_[i].done) {
+                    io_uring_sqe *sqe = ring_.get_sqe();
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->addr = i;
+                    sqe->user_data = (uint64_t) -1;
+                }
+            }
+            while(inflight_) {
+                ring_.enter(1);
+                reap();
+            }
+        }
+#endif
+        if(thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+                cond_.notify_all();
+            }
+            if(::write(wake_[1], "", 1) == -1) {
+                CSM_DEBUG("could not wake reader thread: %s", strerror(errno));
+            }
+            thread_.join();
+        }
+        if(wake_[0] != -1) {
+            ::close(wake_[0]);
+            ::close(wake_[1]);
+        }
+        free(bufs_);
+    }
+
+    /**
+     * Return true if reads are queued using io_uring, or false if the
+     * background thread is in use.
+     */
+    bool using_io_uring() const
+    {
+        return uring_;
+    }
+
+    virtual ssize_t readmore()
+    {
+        if(eof_) {
+            return 0;
+        }
+
+        Slot &slot = wait(slots_[head_]);
+        if(slot.error) {
+            eof_ = true;
+            throw Error("read", strerror(slot.error));
+        }
+
+        size_t n = slot.filled;
+        if(n) {
+            ensure(n);
+            memcpy(&vec_[write_pos_], slot.buf, n);
+        }
+
+        if(slot.eof) {
+            eof_ = true;
+        } else {
+            queue(slot);
+            head_ = (head_ + 1) % slots_.size();
+        }
+#ifdef CSM_USE_IO_URING
+        if(uring_) {
+            ring_.enter(0);
+        }
+#endif
+        return n ? (ssize_t) n : readmore();
+    }
+};
+
+
+/**
+ * Lock-free ring buffer passing values from exactly one producer thread to
+ * exactly one consumer thread. Holds up to `capacity` values.
+ */
+template<class T>
+class SpscQueue
+{
+    std::vector<T> items_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+    public:
+    SpscQueue(size_t capacity)
+        : items_(capacity + 1)
+        , head_(0)
+        , tail_(0)
+    {
+    }
+
+    bool empty() const
+    {
+        return head_.load() == tail_.load();
+    }
+
+    bool full() const
+    {
+        return ((tail_.load() + 1) % items_.size()) == head_.load();
+    }
+
+    /**
+     * Move `item` onto the queue, returning false if the queue is full.
+     */
+    bool push(T &item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % items_.size();
+        if(next == head_.load()) {
+            return false;
+        }
+        items_[tail] = std::move(item);
+        tail_.store(next);
+        return true;
+    }
+
+    /**
+     * Move the oldest value into `item`, returning false if the queue is
+     * empty.
+     */
+    bool pop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(head == tail_.load()) {
+            return false;
+        }
+        item = std::move(items_[head]);
+        head_.store((head + 1) % items_.size());
+        return true;
+    }
+};
+
+
+/**
+ * Wrap another StreamCursor, reading ahead of the parser on a background
+ * thread so IO overlaps with parsing. The thread copies each buffer produced
+ * by the source's fill() into one of `depth` chunks, handing full chunks to
+ * the reader and empty ones back via a pair of SpscQueues. Neither side takes
+ * a lock unless it must sleep because its queue is empty.
+ *
+ * The source is used exclusively by the background thread once reading
+ * starts, and any exception it throws is rethrown from fill(). Subclasses may
+ * override the source_*() and wait_*() hooks, for example to acquire an
+ * interpreter lock around source reads, and release it while the reader waits
+ * for input. Such subclasses must call stop() from their destructor.
+ */
+class ReadAheadStreamCursor
+    : public BufferedStreamCursor
+{
+    struct Chunk
+    {
+        std::vector<char> data;
+        size_t size;
+        bool eof;
+    };
+
+    StreamCursor &source_;
+    SpscQueue<Chunk> full_;
+    SpscQueue<Chunk> free_;
+    std::exception_ptr error_;
+    std::thread thread_;
+    std::atomic<bool> stop_;
+    std::atomic<size_t> waiters_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool eof_;
+
+    template<class Pred>
+    void sleep_until(Pred ready)
+    {
+        if(ready()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_++;
+        cond_.wait(lock, ready);
+        waiters_--;
+    }
+
+    void wake()
+    {
+        if(waiters_.load()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cond_.notify_all();
+        }
+    }
+
+    /**
+     * Copy the source's current buffer into `chunk`, returning false at EOF.
+     */
+    bool read_chunk(Chunk &chunk)
+    {
+        bool more = true;
+        if(! source_.size()) {
+            source_begin();
+            try {
+                more = source_.fill();
+#ifdef __GLIBCXX__
+            } catch(abi::__forced_unwind &) {
+                throw;
+#endif
+            } catch(...) {
+                source_end();
+                throw;
+            }
+            source_end();
+        }
+
+        chunk.size = source_.size();
+        if(chunk.data.size() < chunk.size) {
+            chunk.data.resize(chunk.size);
+        }
+        memcpy(chunk.data.data(), source_.buf(), chunk.size);
+        source_.consume(chunk.size);
+        return more;
+    }
+
+    void run()
+    {
+        for(bool more = true; more;) {
+            Chunk chunk{};
+            sleep_until([&] { return stop_.load() || ! free_.empty(); });
+            if(stop_.load() || ! free_.pop(chunk)) {
+                return;
+            }
+
+            try {
+                more = read_chunk(chunk);
+#ifdef __GLIBCXX__
+            } catch(abi::__forced_unwind &) {
+                // The thread is exiting via pthread_exit(), e.g. when a
+                // source_begin() hook finds the Python interpreter finalizing.
+                // Unblock the reader, then let the unwind continue.
+                error_ = std::make_exception_ptr(
+                    Error("ReadAheadStreamCursor", "reader thread exited"));
+                chunk.size = 0;
+                chunk.eof = true;
+                full_.push(chunk);
+                wake();
+                throw;
+#endif
+            } catch(...) {
+                error_ = std::current_exception();
+                chunk.size = 0;
+                more = false;
+            }
+            chunk.eof = ! more;
+            full_.push(chunk);
+            wake();
+        }
+    }
+
+    protected:
+    /**
+     * Called on the background thread around each source fill().
+     */
+    virtual void source_begin() {}
+    virtual void source_end() {}
+
+    /**
+     * Called on the reader's thread around periods spent sleeping while the
+     * background thread catches up, or while stop() joins it.
+     */
+    virtual void wait_begin() {}
+    virtual void wait_end() {}
+
+    /**
+     * Stop and join the background thread. The thread can only exit between
+     * source reads, so this waits for any read in progress.
+     */
+    void stop()
+    {
+        if(thread_.joinable()) {
+            wait_begin();
+            stop_ = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                cond_.notify_all();
+            }
+            thread_.join();
+            wait_end();
+        }
+    }
+
+    public:
+    ReadAheadStreamCursor(StreamCursor &source, size_t depth=4,
+                          size_t chunk_size=131072)
+        : BufferedStreamCursor()
+        , source_(source)
+        , full_(std::max(depth, (size_t) 1))
+        , free_(std::max(depth, (size_t) 1))
+        , stop_(false)
+        , waiters_(0)
+        , eof_(false)
+    {
+        for(size_t i = 0; i < std::max(depth, (size_t) 1); i++) {
+            Chunk chunk{};
+            chunk.data.resize(chunk_size);
+            free_.push(chunk);
+        }
+    }
+
+    ~ReadAheadStreamCursor()
+    {
+        stop();
+    }
+
+    virtual ssize_t readmore()
+    {
+        if(eof_) {
+            return 0;
+        }
+        if(! thread_.joinable()) {
+            // Started here rather than in the constructor, so any overridden
+            // hooks are in place.
+            thread_ = std::thread(&ReadAheadStreamCursor::run, this);
+        }
+
+        Chunk chunk{};
+        while(! full_.pop(chunk)) {
+            wait_begin();
+            sleep_until([&] { return ! full_.empty(); });
+            wait_end();
+        }
+
+        size_t n = chunk.size;
+        if(n) {
+            ensure(n);
+            memcpy(&vec_[write_pos_], chunk.data.data(), n);
+        }
+        eof_ = chunk.eof;
+        free_.push(chunk);
+        wake();
+
+        if(eof_ && error_) {
+            std::rethrow_exception(error_);
+        }
+        return n ? (ssize_t) n : readmore();
+    }
+};
+
+
+/**
+ * Cursor over a fixed range of memory owned by someone else, such as one chunk
+ * of a MappedFileCursor. Memory following the range must remain readable up to
+ * the first newline, or the buffer's trailing NULs, for the benefit of
+ * StringSpanner.
+ */
+class BufferCursor
+    : public StreamCursor
+{
+    const char *p_;
+    const char *endp_;
+
+    public:
+    BufferCursor(const char *p=0, const char *endp=0)
+        : p_(p)
+        , endp_(endp)
+    {
+    }
+
+    void reset(const char *p, const char *endp)
+    {
+        p_ = p;
+        endp_ = endp;
+    }
+
+    const char *buf()
+    {
+        return p_;
+    }
+
+    size_t size()
+    {
+        return endp_ - p_;
+    }
+
+    void consume(size_t n)
+    {
+        p_ += std::min(n, (size_t) (endp_ - p_));
+    }
+
+    bool fill()
+    {
+        return false;
+    }
+};
+
+
+/**
+ * Instruction set used by CsvReader and StructuralIndex. kCsmKernelAuto
+ * selects the best kernel supported by the running CPU.
+ */
+enum CsmKernel
+{
+    kCsmKernelAuto,
+    kCsmKernelFallback,
+    kCsmKernelSse42,
+    kCsmKernelAvx2,
+    kCsmKernelAvx512
+};
+
+
+static const char *const kernel_names[] = {
+    "auto",
+    "fallback",
+    "sse42",
+    "avx2",
+    "avx512"
+};
+
+
+inline const char *
+kernel_name(CsmKernel kernel)
+{
+    return kernel_names[kernel];
+}
+
+
+/**
+ * Return true if the running CPU supports `kernel`, as reported by CPUID.
+ */
+inline bool
+kernel_supported(CsmKernel kernel)
+{
+    switch(kernel) {
+    case kCsmKernelAuto:
+    case kCsmKernelFallback:
+        return true;
+#ifdef CSM_X86
+    case kCsmKernelSse42:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+    case kCsmKernelAvx2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("pclmul");
+    case kCsmKernelAvx512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("pclmul");
+#endif
+    default:
+        return false;
+    }
+}
+
+
+/**
+ * Resolve kCsmKernelAuto to a concrete kernel. If the CSVMONKEY_KERNEL
+ * environment variable names a supported kernel, it is used, allowing a
+ * specific kernel to be forced for benchmarking without recompiling.
+ * Otherwise the best supported kernel is chosen.
+ */
+inline CsmKernel
+resolve_kernel(CsmKernel kernel)
+{
+    if(kernel != kCsmKernelAuto) {
+        return kernel;
+    }
+
+    const char *env = ::getenv("CSVMONKEY_KERNEL");
+    if(env) {
+        for(int i = kCsmKernelFallback; i <= kCsmKernelAvx512; i++) {
+            CsmKernel k = (CsmKernel) i;
+            if((! strcmp(env, kernel_name(k))) && kernel_supported(k)) {
+                return k;
+            }
+        }
+    }
+
+    for(int i = kCsmKernelAvx512; i > kCsmKernelFallback; i--) {
+        if(kernel_supported((CsmKernel) i)) {
+            return (CsmKernel) i;
+        }
+    }
+    return kCsmKernelFallback;
+}
+
+
+/**
+ * Return true if SSE4.2 versions of helpers such as parse_digits() should be
+ * used, as decided once by resolve_kernel().
+ */
+inline bool
+use_sse42()
+{
+    static const bool sse42 = resolve_kernel(kCsmKernelAuto) >= kCsmKernelSse42;
+    return sse42;
+}
+
+
+/**
+ * Return the high 64 bits of the 128-bit product of `a` and `b`, storing the
+ * low 64 bits in `lo`.
+ */
+inline uint64_t
+mul128(uint64_t a, uint64_t b, uint64_t &lo)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = (unsigned __int128) a * b;
+    lo = (uint64_t) r;
+    return (uint64_t) (r >> 64);
+#else
+    uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t) b, b_hi = b >> 32;
+    uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+    uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+    uint64_t mid = (ll >> 32) + (uint32_t) lh + (uint32_t) hl;
+    lo = (mid << 32) | (uint32_t) ll;
+    return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+
+/**
+ * 128-bit approximations of 5^q for q in -342..308, normalized so the most
+ * significant bit is set. Negative powers are rounded up, positive powers
+ * truncated.
+ */
+inline const uint64_t (*powers_of_five())[2]
+{
+    static const uint64_t table[651][2] = {
+        {0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL},
+        {0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL},
+        {0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL},
+        {0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL},
+        {0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL},
+        {0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL},
+        {0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL},
+        {0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL},
+        {0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL},
+        {0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL},
+        {0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL},
+        {0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL},
+        {0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL},
+        {0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL},
+        {0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL},
+        {0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL},
+        {0x84a57695fe98746dULL, 0x014bb630f7604b57ULL},
+        {0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL},
+        {0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL},
+        {0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL},
+        {0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL},
+        {0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL},
+        {0xfd00b897478238d0ULL, 0x8920b098955522b4ULL},
+        {0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL},
+        {0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL},
+        {0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL},
+        {0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL},
+        {0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL},
+        {0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL},
+        {0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL},
+        {0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL},
+        {0xeba09271e88d976bULL, 0xf7864a44c633682eULL},
+        {0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL},
+        {0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL},
+        {0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL},
+        {0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL},
+        {0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL},
+        {0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL},
+        {0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL},
+        {0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL},
+        {0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL},
+        {0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL},
+        {0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL},
+        {0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL},
+        {0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL},
+        {0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL},
+        {0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL},
+        {0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL},
+        {0xa37fce126597973cULL, 0xe50ff107bab528a0ULL},
+        {0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL},
+        {0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL},
+        {0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL},
+        {0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL},
+        {0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL},
+        {0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL},
+        {0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL},
+        {0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL},
+        {0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL},
+        {0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL},
+        {0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL},
+        {0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL},
+        {0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL},
+        {0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL},
+        {0x91376c36d99995beULL, 0x23100809b9c21fa1ULL},
+        {0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL},
+        {0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL},
+        {0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL},
+        {0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL},
+        {0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL},
+        {0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL},
+        {0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL},
+        {0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL},
+        {0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL},
+        {0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL},
+        {0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL},
+        {0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL},
+        {0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL},
+        {0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL},
+        {0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL},
+        {0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL},
+        {0xc987434744ac874eULL, 0xa327ffb266b56220ULL},
+        {0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL},
+        {0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL},
+        {0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL},
+        {0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL},
+        {0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL},
+        {0xc0314325637a1939ULL, 0xfa911155fefb5308ULL},
+        {0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL},
+        {0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL},
+        {0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL},
+        {0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL},
+        {0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL},
+        {0xb749faed14125d36ULL, 0xcef980ec671f667bULL},
+        {0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL},
+        {0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL},
+        {0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL},
+        {0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL},
+        {0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL},
+        {0xaecc49914078536dULL, 0x58fae9f773886e18ULL},
+        {0xda7f5bf590966848ULL, 0xaf39a475506a899eULL},
+        {0x888f99797a5e012dULL, 0x6d8406c952429603ULL},
+        {0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL},
+        {0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL},
+        {0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL},
+        {0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL},
+        {0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL},
+        {0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL},
+        {0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL},
+        {0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL},
+        {0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL},
+        {0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL},
+        {0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL},
+        {0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL},
+        {0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL},
+        {0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL},
+        {0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL},
+        {0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL},
+        {0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL},
+        {0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL},
+        {0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL},
+        {0xb913179899f68584ULL, 0x28e2557b59846e3fULL},
+        {0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL},
+        {0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL},
+        {0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL},
+        {0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL},
+        {0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL},
+        {0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL},
+        {0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL},
+        {0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL},
+        {0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL},
+        {0xd77485cb25823ac7ULL, 0x7d633293366b828bULL},
+        {0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL},
+        {0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL},
+        {0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL},
+        {0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL},
+        {0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL},
+        {0xcd795be870516656ULL, 0x67902e276c921f8bULL},
+        {0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL},
+        {0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL},
+        {0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL},
+        {0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL},
+        {0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL},
+        {0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL},
+        {0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL},
+        {0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL},
+        {0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL},
+        {0xef340a98172aace4ULL, 0x86fb897116c87c34ULL},
+        {0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL},
+        {0xbae0a846d2195712ULL, 0x8974836059cca109ULL},
+        {0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL},
+        {0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL},
+        {0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL},
+        {0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL},
+        {0x8e938662882af53eULL, 0x547eb47b7282ee9cULL},
+        {0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL},
+        {0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL},
+        {0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL},
+        {0xae0b158b4738705eULL, 0x9624ab50b148d445ULL},
+        {0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL},
+        {0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL},
+        {0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL},
+        {0xd47487cc8470652bULL, 0x7647c3200069671fULL},
+        {0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL},
+        {0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL},
+        {0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL},
+        {0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL},
+        {0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL},
+        {0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL},
+        {0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL},
+        {0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL},
+        {0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL},
+        {0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL},
+        {0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL},
+        {0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL},
+        {0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL},
+        {0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL},
+        {0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL},
+        {0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL},
+        {0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL},
+        {0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL},
+        {0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL},
+        {0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL},
+        {0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL},
+        {0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL},
+        {0x8c974f7383725573ULL, 0x1e414218c73a13fbULL},
+        {0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL},
+        {0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL},
+        {0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL},
+        {0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL},
+        {0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL},
+        {0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL},
+        {0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL},
+        {0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL},
+        {0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL},
+        {0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL},
+        {0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL},
+        {0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL},
+        {0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL},
+        {0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL},
+        {0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL},
+        {0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL},
+        {0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL},
+        {0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL},
+        {0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL},
+        {0xbe89523386091465ULL, 0xf6bbb397f1135823ULL},
+        {0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL},
+        {0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL},
+        {0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL},
+        {0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL},
+        {0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL},
+        {0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL},
+        {0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL},
+        {0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL},
+        {0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL},
+        {0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL},
+        {0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL},
+        {0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL},
+        {0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL},
+        {0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL},
+        {0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL},
+        {0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL},
+        {0x843610cb4bf160cbULL, 0xcedf722a585139baULL},
+        {0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL},
+        {0xce947a3da6a9273eULL, 0x733d226229feea32ULL},
+        {0x811ccc668829b887ULL, 0x0806357d5a3f525fULL},
+        {0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL},
+        {0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL},
+        {0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL},
+        {0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL},
+        {0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL},
+        {0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL},
+        {0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL},
+        {0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL},
+        {0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL},
+        {0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL},
+        {0xbbe226efb628afeaULL, 0x890489f70a55368bULL},
+        {0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL},
+        {0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL},
+        {0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL},
+        {0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL},
+        {0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL},
+        {0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL},
+        {0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL},
+        {0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL},
+        {0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL},
+        {0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL},
+        {0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL},
+        {0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL},
+        {0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL},
+        {0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL},
+        {0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL},
+        {0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL},
+        {0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL},
+        {0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL},
+        {0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL},
+        {0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL},
+        {0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL},
+        {0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL},
+        {0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL},
+        {0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL},
+        {0xc24452da229b021bULL, 0xfbe85badce996168ULL},
+        {0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL},
+        {0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL},
+        {0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL},
+        {0xed246723473e3813ULL, 0x290123e9aab23b68ULL},
+        {0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL},
+        {0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL},
+        {0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL},
+        {0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL},
+        {0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL},
+        {0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL},
+        {0x8d590723948a535fULL, 0x579c487e5a38ad0eULL},
+        {0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL},
+        {0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL},
+        {0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL},
+        {0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL},
+        {0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL},
+        {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL},
+        {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL},
+        {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL},
+        {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL},
+        {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL},
+        {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL},
+        {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL},
+        {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL},
+        {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL},
+        {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL},
+        {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL},
+        {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL},
+        {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL},
+        {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL},
+        {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL},
+        {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL},
+        {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL},
+        {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL},
+        {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL},
+        {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL},
+        {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL},
+        {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL},
+        {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL},
+        {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL},
+        {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL},
+        {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL},
+        {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL},
+        {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL},
+        {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL},
+        {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL},
+        {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL},
+        {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL},
+        {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL},
+        {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL},
+        {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL},
+        {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL},
+        {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL},
+        {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL},
+        {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL},
+        {0xc612062576589ddaULL, 0x95364afe032a819eULL},
+        {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL},
+        {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL},
+        {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL},
+        {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL},
+        {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL},
+        {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL},
+        {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL},
+        {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL},
+        {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL},
+        {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL},
+        {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL},
+        {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL},
+        {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL},
+        {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL},
+        {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL},
+        {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL},
+        {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL},
+        {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL},
+        {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL},
+        {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL},
+        {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL},
+        {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL},
+        {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL},
+        {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL},
+        {0xccccccccccccccccULL, 0xcccccccccccccccdULL},
+        {0x8000000000000000ULL, 0x0000000000000000ULL},
+        {0xa000000000000000ULL, 0x0000000000000000ULL},
+        {0xc800000000000000ULL, 0x0000000000000000ULL},
+        {0xfa00000000000000ULL, 0x0000000000000000ULL},
+        {0x9c40000000000000ULL, 0x0000000000000000ULL},
+        {0xc350000000000000ULL, 0x0000000000000000ULL},
+        {0xf424000000000000ULL, 0x0000000000000000ULL},
+        {0x9896800000000000ULL, 0x0000000000000000ULL},
+        {0xbebc200000000000ULL, 0x0000000000000000ULL},
+        {0xee6b280000000000ULL, 0x0000000000000000ULL},
+        {0x9502f90000000000ULL, 0x0000000000000000ULL},
+        {0xba43b74000000000ULL, 0x0000000000000000ULL},
+        {0xe8d4a51000000000ULL, 0x0000000000000000ULL},
+        {0x9184e72a00000000ULL, 0x0000000000000000ULL},
+        {0xb5e620f480000000ULL, 0x0000000000000000ULL},
+        {0xe35fa931a0000000ULL, 0x0000000000000000ULL},
+        {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL},
+        {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL},
+        {0xde0b6b3a76400000ULL, 0x0000000000000000ULL},
+        {0x8ac7230489e80000ULL, 0x0000000000000000ULL},
+        {0xad78ebc5ac620000ULL, 0x0000000000000000ULL},
+        {0xd8d726b7177a8000ULL, 0x0000000000000000ULL},
+        {0x878678326eac9000ULL, 0x0000000000000000ULL},
+        {0xa968163f0a57b400ULL, 0x0000000000000000ULL},
+        {0xd3c21bcecceda100ULL, 0x0000000000000000ULL},
+        {0x84595161401484a0ULL, 0x0000000000000000ULL},
+        {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL},
+        {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL},
+        {0x813f3978f8940984ULL, 0x4000000000000000ULL},
+        {0xa18f07d736b90be5ULL, 0x5000000000000000ULL},
+        {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL},
+        {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL},
+        {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL},
+        {0xc5371912364ce305ULL, 0x6c28000000000000ULL},
+        {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL},
+        {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL},
+        {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL},
+        {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL},
+        {0x96769950b50d88f4ULL, 0x1314448000000000ULL},
+        {0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL},
+        {0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL},
+        {0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL},
+        {0xb7abc627050305adULL, 0xf14a3d9e40000000ULL},
+        {0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL},
+        {0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL},
+        {0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL},
+        {0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL},
+        {0x8c213d9da502de45ULL, 0x4526f422cc340000ULL},
+        {0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL},
+        {0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL},
+        {0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL},
+        {0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL},
+        {0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL},
+        {0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL},
+        {0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL},
+        {0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL},
+        {0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL},
+        {0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL},
+        {0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL},
+        {0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL},
+        {0x9f4f2726179a2245ULL, 0x01d762422c946590ULL},
+        {0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL},
+        {0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL},
+        {0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL},
+        {0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL},
+        {0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL},
+        {0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL},
+        {0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL},
+        {0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL},
+        {0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL},
+        {0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL},
+        {0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL},
+        {0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL},
+        {0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL},
+        {0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL},
+        {0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL},
+        {0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL},
+        {0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL},
+        {0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL},
+        {0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL},
+        {0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL},
+        {0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL},
+        {0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL},
+        {0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL},
+        {0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL},
+        {0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL},
+        {0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL},
+        {0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL},
+        {0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL},
+        {0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL},
+        {0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL},
+        {0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL},
+        {0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL},
+        {0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL},
+        {0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL},
+        {0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL},
+        {0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL},
+        {0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL},
+        {0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL},
+        {0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL},
+        {0x924d692ca61be758ULL, 0x593c2626705f9c56ULL},
+        {0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL},
+        {0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL},
+        {0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL},
+        {0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL},
+        {0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL},
+        {0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL},
+        {0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL},
+        {0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL},
+        {0x884134fe908658b2ULL, 0x3109058d147fdcddULL},
+        {0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL},
+        {0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL},
+        {0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL},
+        {0xa6539930bf6bff45ULL, 0x84db8346b786151cULL},
+        {0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL},
+        {0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL},
+        {0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL},
+        {0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL},
+        {0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL},
+        {0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL},
+        {0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL},
+        {0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL},
+        {0x9ae757596946075fULL, 0x3375788de9b06958ULL},
+        {0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL},
+        {0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL},
+        {0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL},
+        {0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL},
+        {0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL},
+        {0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL},
+        {0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL},
+        {0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL},
+        {0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL},
+        {0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL},
+        {0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL},
+        {0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL},
+        {0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL},
+        {0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL},
+        {0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL},
+        {0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL},
+        {0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL},
+        {0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL},
+        {0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL},
+        {0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL},
+        {0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL},
+        {0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL},
+        {0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL},
+        {0x802221226be55a64ULL, 0xc2494954da2c9789ULL},
+        {0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL},
+        {0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL},
+        {0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL},
+        {0x9c69a97284b578d7ULL, 0xff2a760414536efbULL},
+        {0xc38413cf25e2d70dULL, 0xfef5138519684abaULL},
+        {0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL},
+        {0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL},
+        {0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL},
+        {0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL},
+        {0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL},
+        {0xba756174393d88dfULL, 0x94f971119aeef9e4ULL},
+        {0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL},
+        {0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL},
+        {0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL},
+        {0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL},
+        {0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL},
+        {0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL},
+        {0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL},
+        {0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL},
+        {0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL},
+        {0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL},
+        {0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL},
+        {0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL},
+        {0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL},
+        {0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL},
+        {0xa59bc234db398c25ULL, 0x43fab9837e699095ULL},
+        {0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL},
+        {0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL},
+        {0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL},
+        {0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL},
+        {0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL},
+        {0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL},
+        {0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL},
+        {0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL},
+        {0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL},
+        {0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL},
+        {0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL},
+        {0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL},
+        {0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL},
+        {0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL},
+        {0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL},
+        {0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL},
+        {0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL},
+        {0x8fa475791a569d10ULL, 0xf96e017d694487bcULL},
+        {0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL},
+        {0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL},
+        {0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL},
+        {0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL},
+        {0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL},
+        {0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL},
+        {0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL},
+        {0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL},
+        {0x85c7056562757456ULL, 0xf6872d5667844e49ULL},
+        {0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL},
+        {0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL},
+        {0x82a45b450226b39cULL, 0xecc0024661173473ULL},
+        {0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL},
+        {0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL},
+        {0xff290242c83396ceULL, 0x7e67047175a15271ULL},
+        {0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL},
+        {0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL},
+        {0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL},
+        {0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL},
+        {0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL},
+        {0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL},
+        {0x98165af37b2153deULL, 0xc3727a337a8b704aULL},
+        {0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL},
+        {0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL},
+        {0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL},
+        {0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL},
+        {0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL},
+        {0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL},
+        {0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL},
+        {0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL},
+        {0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL},
+        {0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL},
+        {0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL},
+        {0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL},
+        {0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL},
+        {0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL},
+        {0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL},
+        {0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL},
+        {0xd31045a8341ca07cULL, 0x1ede48111209a050ULL},
+        {0x83ea2b892091e44dULL, 0x934aed0aab460432ULL},
+        {0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL},
+        {0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL},
+        {0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL},
+        {0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL},
+        {0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL},
+        {0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL},
+        {0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL},
+        {0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL},
+        {0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL},
+        {0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL},
+        {0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL},
+        {0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL},
+        {0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL},
+        {0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL},
+        {0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL},
+        {0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL},
+        {0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL},
+        {0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL},
+        {0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL},
+        {0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL},
+        {0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL},
+        {0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL},
+        {0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL},
+        {0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL},
+        {0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL},
+        {0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL},
+        {0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL},
+        {0x8533285c936b35deULL, 0xd53a88958f87275fULL},
+        {0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL},
+        {0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL},
+        {0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL},
+        {0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL},
+        {0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL},
+        {0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL},
+        {0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL},
+        {0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL},
+        {0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL},
+        {0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL},
+        {0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL},
+        {0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL},
+        {0x976e41088617ca01ULL, 0xd5be0503e085d813ULL},
+        {0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL},
+        {0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL},
+        {0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL},
+        {0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL},
+        {0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL},
+        {0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL},
+        {0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL},
+        {0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL},
+        {0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL},
+        {0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL},
+        {0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL},
+        {0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL},
+        {0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL},
+        {0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL},
+        {0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL},
+        {0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL},
+        {0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL},
+        {0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL},
+        {0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL},
+        {0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL},
+        {0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL},
+        {0xa0555e361951c366ULL, 0xd7e105bcc332621fULL},
+        {0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL},
+        {0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL},
+        {0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL},
+        {0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL},
+        {0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL},
+        {0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL},
+        {0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL},
+        {0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL},
+        {0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL},
+        {0xbaa718e68396cffdULL, 0xd30560258f54e6baULL},
+        {0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL},
+        {0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL},
+        {0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL},
+        {0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL},
+        {0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL}
+    };
+    return table;
+}
+
+
+/**
+ * Compute the binary64 representation of w * 10^q, with `w` nonzero, using
+ * the Eisel-Lemire algorithm. Return false in the rare cases where the
+ * result cannot be determined using 128-bit products.
+ */
+inline bool
+eisel_lemire(int64_t q, uint64_t w, uint64_t &bits)
+{
+    if(q < -342) {
+        bits = 0;
+        return true;
+    } else if(q > 308) {
+        bits = 0x7ffULL << 52;
+        return true;
+    }
+
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+
+    const uint64_t *pow5 = powers_of_five()[q + 342];
+    uint64_t lo;
+    uint64_t hi = mul128(w, pow5[0], lo);
+    // Bits below the 55 needed for rounding are all ones, so the truncated
+    // remainder of 5^q may carry into them.
+    if((hi & 0x1ff) == 0x1ff) {
+        uint64_t lo2;
+        uint64_t hi2 = mul128(w, pow5[1], lo2);
+        lo += hi2;
+        if(hi2 > lo) {
+            hi++;
+        }
+    }
+    if(lo == ~0ULL && (q < -27 || q > 55)) {
+        return false;
+    }
+
+    int upperbit = (int) (hi >> 63);
+    uint64_t mantissa = hi >> (upperbit + 9);
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz + 1023;
+    if(power2 <= 0) {
+        // Subnormal.
+        if(-power2 + 1 >= 64) {
+            bits = 0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = (mantissa < (1ULL << 52)) ? 0 : 1;
+        bits = mantissa | ((uint64_t) power2 << 52);
+        return true;
+    }
+
+    // Exactly halfway between two doubles: round to even.
+    if(lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1
+            && (mantissa << (upperbit + 9)) == hi) {
+        mantissa &= ~1ULL;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if(mantissa >= (2ULL << 52)) {
+        mantissa = 1ULL << 52;
+        power2++;
+    }
+    mantissa &= ~(1ULL << 52);
+    if(power2 >= 0x7ff) {
+        bits = 0x7ffULL << 52;
+        return true;
+    }
+    bits = mantissa | ((uint64_t) power2 << 52);
+    return true;
+}
+
+
+/**
+ * Parse [startp, endp) using strtod() via a NUL-terminated copy.
+ */
+inline double
+parse_double_strtod(const char *startp, const char *endp, const char **endptr)
+{
+    std::string s(startp, endp);
+    char *end;
+    double d = strtod(s.c_str(), &end);
+    if(endptr) {
+        *endptr = startp + (end - s.c_str());
+    }
+    return d;
+}
+
+
+/**
+ * Parse a decimal floating point number from [p, endp), correctly rounded,
+ * never reading beyond `endp`. Accepts the same syntax as strtod(): leading
+ * blanks, an optional sign, digits with an optional decimal point, and an
+ * optional exponent, ignoring any trailing bytes and returning 0 if no
+ * number is present. If `endptr` is not NULL, it receives the end of the
+ * number, or the start of the input if none was found. Infinities, NaNs,
+ * hexadecimal input, and the very rare inputs Eisel-Lemire cannot decide are
+ * passed to strtod() via a copy. Unlike strtod(), the decimal point is
+ * always '.'.
+ */
+inline double
+parse_double(const char *p, const char *endp, const char **endptr=NULL)
+{
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char *startp = p;
+    while(p < endp && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    bool negative = false;
+    if(p < endp && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+
+    // Accumulate up to 19 significant digits in w, such that the value is
+    // w * 10^q, noting whether any nonzero digits were dropped.
+    uint64_t w = 0;
+    int64_t q = 0;
+    int ndigits = 0;
+    bool any = false;
+    bool truncated = false;
+    const char *digitsp = p;
+    for(; p < endp && (unsigned) (*p - '0') < 10; p++) {
+        any = true;
+        if(ndigits < 19) {
+            w = (10 * w) + (*p - '0');
+            ndigits += w != 0;
+        } else {
+            q++;
+            truncated |= *p != '0';
+        }
+    }
+    if(p < endp && *p == '.') {
+        for(p++; p < endp && (unsigned) (*p - '0') < 10; p++) {
+            any = true;
+            if(ndigits < 19) {
+                w = (10 * w) + (*p - '0');
+                ndigits += w != 0;
+                q--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+
+    if(! any || ((p - digitsp) == 1 && *digitsp == '0'
+                 && p < endp && (*p | 0x20) == 'x')) {
+        return parse_double_strtod(startp, endp, endptr);
+    }
+
+    if(p < endp && (*p | 0x20) == 'e') {
+        const char *ep = p + 1;
+        bool exp_negative = false;
+        if(ep < endp && (*ep == '-' || *ep == '+')) {
+            exp_negative = *ep++ == '-';
+        }
+        if(ep < endp && (unsigned) (*ep - '0') < 10) {
+            int64_t e = 0;
+            for(; ep < endp && (unsigned) (*ep - '0') < 10; ep++) {
+                if(e < 100000) {
+                    e = (10 * e) + (*ep - '0');
+                }
+            }
+            q += exp_negative ? -e : e;
+            p = ep;
+        }
+    }
+
+    double d;
+    if(! w) {
+        d = 0;
+#if FLT_EVAL_METHOD == 0
+    } else if(! truncated && q >= -22 && q <= 22 && w <= (1ULL << 53)) {
+        // Clinger's fast path: both operands are exact.
+        d = (double) w;
+        d = (q < 0) ? (d / powers_of_ten[-q]) : (d * powers_of_ten[q]);
+#endif
+    } else {
+        uint64_t bits;
+        uint64_t bits_up;
+        if(! eisel_lemire(q, w, bits)
+                || (truncated && (! eisel_lemire(q, w + 1, bits_up)
+                                  || bits != bits_up))) {
+            return parse_double_strtod(startp, endp, endptr);
+        }
+        memcpy(&d, &bits, sizeof d);
+    }
+    if(endptr) {
+        *endptr = p;
+    }
+    return negative ? -d : d;
+}
+
+
+/**
+ * Result of CsvCell's integer and fixed-point conversions.
+ */
+enum CsmNumberResult
+{
+    kCsmNumberOk,
+    /// Empty, or not entirely an optional sign and digits.
+    kCsmNumberInvalid,
+    /// Out of range, or more nonzero fractional digits than requested.
+    kCsmNumberOverflow
+};
+
+
+/**
+ * Continue parse_digits() from `value`, a digit at a time.
+ */
+inline bool
+parse_digits_tail(const char *&p, const char *endp, uint64_t &value)
+{
+    for(; p < endp && (unsigned) (*p - '0') < 10; p++) {
+        if(__builtin_mul_overflow(value, (uint64_t) 10, &value)
+                || __builtin_add_overflow(value, (uint64_t) (*p - '0'), &value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+#ifdef CSM_X86
+/**
+ * parse_digits() locating and reducing up to 16 digits using SIMD
+ * multiply-adds, then handling any remainder a digit at a time.
+ */
+inline bool CSM_ATTR_SSE42
+parse_digits_sse42(const char *&p, const char *endp, uint64_t &value)
+{
+    // Short input is assembled from overlapping loads ending at endp, so
+    // nothing beyond it is read. The zero padding is not digits.
+    __m128i chunk;
+    size_t avail = endp - p;
+    if(avail >= 16) {
+        chunk = _mm_loadu_si128((const __m128i *) p);
+    } else {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+        if(avail >= 8) {
+            memcpy(&lo, p, 8);
+            memcpy(&hi, endp - 8, 8);
+            hi = (avail > 8) ? (hi >> (8 * (16 - avail))) : 0;
+        } else if(avail >= 4) {
+            uint32_t first, last;
+            memcpy(&first, p, 4);
+            memcpy(&last, endp - 4, 4);
+            lo = first | ((uint64_t) last << (8 * (avail - 4)));
+        } else if(avail) {
+            lo = (uint64_t) (uint8_t) p[0]
+               | ((uint64_t) (uint8_t) p[avail / 2] << (8 * (avail / 2)))
+               | ((uint64_t) (uint8_t) p[avail - 1] << (8 * (avail - 1)));
+        }
+        chunk = _mm_set_epi64x((int64_t) hi, (int64_t) lo);
+    }
+
+    __m128i digits = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+    __m128i nine = _mm_set1_epi8(9);
+    unsigned mask = ~_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_max_epu8(digits, nine), nine));
+    int n = __builtin_ctz(mask | 0x10000);
+    value = 0;
+    if(n) {
+        // Right-align the digits, zero filling: shuffle indices below zero
+        // have their high bit set.
+        __m128i shift = _mm_add_epi8(
+            _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+            _mm_set1_epi8((char) (n - 16)));
+        digits = _mm_shuffle_epi8(digits, shift);
+        digits = _mm_maddubs_epi16(digits, _mm_setr_epi8(
+            10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+        digits = _mm_madd_epi16(digits, _mm_setr_epi16(
+            100, 1, 100, 1, 100, 1, 100, 1));
+        digits = _mm_packus_epi32(digits, digits);
+        digits = _mm_madd_epi16(digits, _mm_setr_epi16(
+            10000, 1, 10000, 1, 10000, 1, 10000, 1));
+        uint64_t halves = (uint64_t) _mm_cvtsi128_si64(digits);
+        value = ((halves & 0xffffffff) * 100000000) + (halves >> 32);
+        p += n;
+    }
+    return (n < 16) || parse_digits_tail(p, endp, value);
+}
+#endif // CSM_X86
+
+
+/**
+ * Parse the run of decimal digits at the start of [p, endp) into `value`,
+ * advancing `p` past them. Return false if the value exceeds 2^64-1. Uses
+ * parse_digits_sse42() when use_sse42() is true.
+ */
+inline bool
+parse_digits(const char *&p, const char *endp, uint64_t &value)
+{
+#ifdef CSM_X86
+    if(use_sse42()) {
+        return parse_digits_sse42(p, endp, value);
+    }
+#endif
+    value = 0;
+    return parse_digits_tail(p, endp, value);
+}
+
+
+/**
+ * Parse [p, endp) as a sign and magnitude.
+ */
+inline CsmNumberResult
+parse_integer(const char *p, const char *endp, bool &negative, uint64_t &value)
+{
+    negative = false;
+    if(p < endp && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+
+    const char *digitsp = p;
+    bool ok = parse_digits(p, endp, value);
+    if(p == digitsp || (ok && p != endp)) {
+        return kCsmNumberInvalid;
+    }
+    return ok ? kCsmNumberOk : kCsmNumberOverflow;
+}
+
+
+/**
+ * Parse [p, endp) as a decimal number with an optional sign and fractional
+ * part, producing the value multiplied by 10^scale. Fractional digits beyond
+ * `scale` must be zero.
+ */
+inline CsmNumberResult
+parse_decimal(const char *p, const char *endp, int scale, int64_t &out)
+{
+    static const uint64_t powers_of_ten[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+        10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+        100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL
+    };
+    if(scale < 0 || scale > 18) {
+        return kCsmNumberOverflow;
+    }
+
+    bool negative = false;
+    if(p < endp && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+
+    const char *intp = p;
+    uint64_t whole;
+    if(! parse_digits(p, endp, whole)) {
+        return kCsmNumberOverflow;
+    }
+    size_t ndigits = p - intp;
+
+    uint64_t frac = 0;
+    if(p < endp && *p == '.') {
+        const char *fracp = ++p;
+        // Parse no more than `scale` digits, then require zeros.
+        const char *limitp = p + std::min((ptrdiff_t) scale, endp - p);
+        parse_digits(p, limitp, frac);
+        frac *= powers_of_ten[scale - (p - fracp)];
+        ndigits += p - fracp;
+        for(; p < endp && *p == '0'; p++) {
+            ndigits++;
+        }
+        if(p < endp && (unsigned) (*p - '0') < 10) {
+            return kCsmNumberOverflow;
+        }
+    }
+    if(! ndigits || p != endp) {
+        return kCsmNumberInvalid;
+    }
+
+    uint64_t value;
+    if(__builtin_mul_overflow(whole, powers_of_ten[scale], &value)
+            || __builtin_add_overflow(value, frac, &value)
+            || value > (negative ? (1ULL << 63) : ((1ULL << 63) - 1))) {
+        return kCsmNumberOverflow;
+    }
+    out = negative ? (int64_t) (0 - value) : (int64_t) value;
+    return kCsmNumberOk;
+}
+
+
+/**
+ * Parse exactly `n` digits from `p`, advancing past them.
+ */
+inline bool
+parse_fixed_digits(const char *&p, const char *endp, int n, int &value)
+{
+    if((endp - p) < n) {
+        return false;
+    }
+    value = 0;
+    for(const char *e = p + n; p < e; p++) {
+        if((unsigned) (*p - '0') >= 10) {
+            return false;
+        }
+        value = (10 * value) + (*p - '0');
+    }
+    return true;
+}
+
+
+/**
+ * Return the number of days from 1970-01-01 to the given proleptic Gregorian
+ * date, by Howard Hinnant's days_from_civil().
+ */
+inline int64_t
+days_from_civil(int64_t year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yoe = (unsigned) (year - (era * 400));
+    unsigned doy = ((153 * (month + (month > 2 ? -3 : 9))) + 2) / 5 + day - 1;
+    unsigned doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+    return (era * 146097) + (int64_t) doe - 719468;
+}
+
+
+#ifdef CSM_X86
+/**
+ * Parse the 16 bytes at `p` as "YYYY-MM-DD HH:MM", with 'T' or a space
+ * separating date and time, returning false if they do not have that form.
+ */
+inline bool CSM_ATTR_SSE42
+parse_timestamp_prefix_sse42(const char *p, int &year, int &month, int &day,
+                             int &hour, int &minute)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    __m128i digits = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i nine = _mm_set1_epi8(9);
+    // Bytes that are digits, or the expected separator.
+    unsigned ok = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(digits, nine), nine))
+        & 0xdb6f;
+    ok |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setr_epi8(
+        0, 0, 0, 0, '-', 0, 0, '-', 0, 0, ' ', 0, 0, ':', 0, 0))) & 0x2490;
+    ok |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'T', 0, 0, 0, 0, 0))) & 0x400;
+    if((ok & 0xffff) != 0xffff) {
+        return false;
+    }
+
+    // Gather digit pairs and combine them: YY YY MM DD hh mm.
+    __m128i pairs = _mm_shuffle_epi8(digits, _mm_setr_epi8(
+        0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1));
+    pairs = _mm_maddubs_epi16(pairs, _mm_setr_epi8(
+        10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0));
+    year = (_mm_extract_epi16(pairs, 0) * 100) + _mm_extract_epi16(pairs, 1);
+    month = _mm_extract_epi16(pairs, 2);
+    day = _mm_extract_epi16(pairs, 3);
+    hour = _mm_extract_epi16(pairs, 4);
+    minute = _mm_extract_epi16(pairs, 5);
+    return true;
+}
+#endif // CSM_X86
+
+
+/**
+ * Parse an ISO 8601 timestamp from [p, endp) as microseconds since the UNIX
+ * epoch. Accepts "YYYY-MM-DD", optionally followed by 'T' or a space and
+ * "HH:MM", then optionally ":SS" with a fraction of 1 to 9 digits following
+ * '.' or ',', then optionally 'Z' or an offset of the form "+HH", "+HHMM" or
+ * "+HH:MM". Timestamps without an offset are taken to be UTC. Fraction
+ * digits beyond microseconds are truncated.
+ *
+ * When use_sse42() is true, the common "YYYY-MM-DD HH:MM" prefix of longer
+ * input is validated and its digits extracted with SIMD, otherwise a byte at
+ * a time.
+ */
+inline CsmNumberResult
+parse_timestamp(const char *p, const char *endp, int64_t &out)
+{
+    static const uint8_t days_in_month[] = {
+        31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+    };
+    int year, month, day;
+    int hour = 0, minute = 0, second = 0;
+    bool has_time = false;
+
+#ifdef CSM_X86
+    if((endp - p) >= 16 && use_sse42()
+            && parse_timestamp_prefix_sse42(p, year, month, day, hour, minute)) {
+        has_time = true;
+        p += 16;
+    }
+    if(! has_time)
+#endif
+    {
+        if(! (parse_fixed_digits(p, endp, 4, year)
+              && p < endp && *p++ == '-'
+              && parse_fixed_digits(p, endp, 2, month)
+              && p < endp && *p++ == '-'
+              && parse_fixed_digits(p, endp, 2, day))) {
+            return kCsmNumberInvalid;
+        }
+        if(p < endp && (*p == 'T' || *p == ' ')) {
+            p++;
+            if(! (parse_fixed_digits(p, endp, 2, hour)
+                  && p < endp && *p++ == ':'
+                  && parse_fixed_digits(p, endp, 2, minute))) {
+                return kCsmNumberInvalid;
+            }
+            has_time = true;
+        }
+    }
+
+    int64_t micros = 0;
+    if(has_time && p < endp && *p == ':') {
+        p++;
+        if(! parse_fixed_digits(p, endp, 2, second)) {
+            return kCsmNumberInvalid;
+        }
+        if(p < endp && (*p == '.' || *p == ',')) {
+            const char *fracp = ++p;
+            for(; p < endp && (unsigned) (*p - '0') < 10; p++) {
+                if((p - fracp) < 6) {
+                    micros = (10 * micros) + (*p - '0');
+                }
+            }
+            if(p == fracp || (p - fracp) > 9) {
+                return kCsmNumberInvalid;
+            }
+            for(ptrdiff_t i = p - fracp; i < 6; i++) {
+                micros *= 10;
+            }
+        }
+    }
+
+    int offset = 0;
+    if(has_time && p < endp) {
+        if(*p == 'Z' || *p == 'z') {
+            p++;
+        } else if(*p == '+' || *p == '-') {
+            int sign = (*p++ == '-') ? -1 : 1;
+            int offset_hour, offset_minute = 0;
+            if(! parse_fixed_digits(p, endp, 2, offset_hour)) {
+                return kCsmNumberInvalid;
+            }
+            if(p < endp) {
+                if(*p == ':') {
+                    p++;
+                }
+                if(! parse_fixed_digits(p, endp, 2, offset_minute)) {
+                    return kCsmNumberInvalid;
+                }
+            }
+            if(offset_hour > 23 || offset_minute > 59) {
+                return kCsmNumberInvalid;
+            }
+            offset = sign * ((offset_hour * 60) + offset_minute) * 60;
+        }
+    }
+
+    if(p != endp || month < 1 || month > 12 || day < 1 || hour > 23
+            || minute > 59 || second > 59) {
+        return kCsmNumberInvalid;
+    }
+    bool leap = (year % 4) == 0 && ((year % 100) != 0 || (year % 400) == 0);
+    if(day > (days_in_month[month - 1] + (month == 2 && leap))) {
+        return kCsmNumberInvalid;
+    }
+
+    int64_t seconds = (days_from_civil(year, month, day) * 86400)
+        + (hour * 3600) + (minute * 60) + second - offset;
+    out = (seconds * 1000000) + micros;
+    return kCsmNumberOk;
+}
+
+
+struct CsvCell
+{
+    const char *ptr;
+    size_t size;
+
+    char escapechar;
+    char quotechar;
+    bool escaped;
+
+    std::string as_str()
+    {
+        auto s = std::string(ptr, size);
+        if(escaped) {
+            int o = 0;
+            for(size_t i = 0; i < s.size();) {
+                char c = s[i];
+                if((escapechar && c == escapechar) || (c == quotechar)) {
+                    i++;
+                }
+                s[o++] = s[i++];
+            }
+            s.resize(o);
+        }
+        return s;
+    }
+
+    bool startswith(const char *str) const
+    {
+        return std::string(ptr, std::min(size, strlen(str))) == str;
+    }
+
+    bool equals(const char *str) const
+    {
+        auto p = ptr;
+        for(auto len = size; len--;) {
+            if((! *p) || *str++ != *p++) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double as_double()
+    {
+#ifdef USE_SPIRIT
+        namespace qi = boost::spirit::qi;
+        using qi::double_;
+        double n;
+        qi::parse(ptr, ptr+size, double_, n);
+        return n;
+#else
+        if(escaped) {
+            std::string s = as_str();
+            return parse_double(s.data(), s.data() + s.size());
+        }
+        return parse_double(ptr, ptr + size);
+#endif
+    }
+
+    /**
+     * Parse the field as a decimal integer with an optional sign, storing
+     * it in `out`. Leaves `out` unchanged unless kCsmNumberOk is returned.
+     */
+    CsmNumberResult as_int64(int64_t &out)
+    {
+        if(escaped) {
+            std::string s = as_str();
+            return CsvCell { s.data(), s.size(), 0, 0, false }.as_int64(out);
+        }
+
+        bool negative;
+        uint64_t value;
+        CsmNumberResult result = parse_integer(ptr, ptr + size, negative, value);
+        if(result == kCsmNumberOk) {
+            if(value > (negative ? (1ULL << 63) : ((1ULL << 63) - 1))) {
+                return kCsmNumberOverflow;
+            }
+            out = negative ? (int64_t) (0 - value) : (int64_t) value;
+        }
+        return result;
+    }
+
+    /**
+     * As as_int64(), for unsigned integers. A minus sign is only accepted
+     * for zero.
+     */
+    CsmNumberResult as_uint64(uint64_t &out)
+    {
+        if(escaped) {
+            std::string s = as_str();
+            return CsvCell { s.data(), s.size(), 0, 0, false }.as_uint64(out);
+        }
+
+        bool negative;
+        uint64_t value;
+        CsmNumberResult result = parse_integer(ptr, ptr + size, negative, value);
+        if(result == kCsmNumberOk) {
+            if(negative && value) {
+                return kCsmNumberOverflow;
+            }
+            out = value;
+        }
+        return result;
+    }
+
+    /**
+     * Parse the field as a fixed-point decimal, such as "-12.3400", storing
+     * its value multiplied by 10^scale in `out`, for `scale` up to 18.
+     * Fractional digits beyond `scale` must be zero, since the result would
+     * otherwise be inexact. Leaves `out` unchanged unless kCsmNumberOk is
+     * returned.
+     */
+    CsmNumberResult as_decimal(int scale, int64_t &out)
+    {
+        if(escaped) {
+            std::string s = as_str();
+            return CsvCell { s.data(), s.size(), 0, 0, false }.as_decimal(scale, out);
+        }
+        return parse_decimal(ptr, ptr + size, scale, out);
+    }
+
+    /**
+     * Parse the field as an ISO 8601 timestamp, such as "2017-01-02 03:04:05"
+     * or "2017-01-02T03:04:05.123Z", storing microseconds since the UNIX
+     * epoch in `out`. See parse_timestamp() for the accepted forms. Leaves
+     * `out` unchanged unless kCsmNumberOk is returned.
+     */
+    CsmNumberResult as_timestamp(int64_t &out)
+    {
+        if(escaped) {
+            std::string s = as_str();
+            return CsvCell { s.data(), s.size(), 0, 0, false }.as_timestamp(out);
+        }
+        return parse_timestamp(ptr, ptr + size, out);
+    }
+};
+
+
+struct FieldPair
+{
+    const char *name;
+    CsvCell **cell;
+};
+
+
+/**
+ * Callable that matches a set of up to 5 bytes (including NUL) in a 16 byte
+ * string. The index 0..15 of the first occurrence is returned, otherwise 16 is
+ * returned if no match is found or NUL is encountered.
+ */
+struct StringSpannerFallback
+{
+    uint8_t charset_[256];
+
+    StringSpannerFallback(char c1=0, char c2=0, char c3=0, char c4=0)
+    {
+        ::memset(charset_, 0, sizeof charset_);
+        charset_[(unsigned) c1] = 1;
+        charset_[(unsigned) c2] = 1;
+        charset_[(unsigned) c3] = 1;
+        charset_[(unsigned) c4] = 1;
+        charset_[0] = 1;
+    }
+
+    size_t
+    operator()(const char *s)
+        __attribute__((__always_inline__))
+    {
+        CSM_DEBUG("bitfield[32] = %d", charset_[32]);
+        CSM_DEBUG("span[0] = {%d,%d,%d,%d,%d,%d,%d,%d}",
+            s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]);
+        CSM_DEBUG("span[1] = {%d,%d,%d,%d,%d,%d,%d,%d}",
+            s[8], s[9], s[10], s[11], s[12], s[13], s[14], s[15]);
+
+        auto p = (const unsigned char *)s;
+        auto e = p + 16;
+
+        do {
+            if(charset_[p[0]]) {
+                break;
+            }
+            if(charset_[p[1]]) {
+                p++;
+                break;
+            }
+            if(charset_[p[2]]) {
+                p += 2;
+                break;
+            }
+            if(charset_[p[3]]) {
+                p += 3;
+                break;
+            }
+            p += 4;
+        } while(p < e);
+
+        if(! *p) {
+            return 16; // PCMPISTRI reports NUL encountered as no match.
+        }
+
+        return p - (const unsigned char *)s;
+    }
+};
+
+
+#ifdef CSM_X86
+struct alignas(16) StringSpannerSse42
+{
+    __m128i v_;
+
+    StringSpannerSse42(char c1=0, char c2=0, char c3=0, char c4=0)
+    {
+        assert(! ((reinterpret_cast<intptr_t>(&v_) & 15)));
+        __v16qi vq = {c1, c2, c3, c4};
+        v_ = (__m128i) vq;
+    }
+
+    size_t CSM_ATTR_SSE42
+    operator()(const char *buf)
+    {
+        return _mm_cmpistri(
+            v_,
+            _mm_loadu_si128((__m128i *) buf),
+            0
+        );
+    }
+};
+
+#endif // CSM_X86
+
+
+#ifdef CSM_USE_SSE42
+using StringSpanner = StringSpannerSse42;
+#else
+using StringSpanner = StringSpannerFallback;
+#endif
+
+
+/**
+ * Adapt a 16 byte StringSpanner to the interface expected by
+ * CsvReader::try_parse(): two back-to-back probes covering 32 bytes, returning
+ * the index 0..31 of the first match, or 32 if no match was found.
+ */
+template<class Spanner>
+struct PairedSpanner
+{
+    static const size_t kWidth = 32;
+    Spanner spanner_;
+
+    PairedSpanner(char c1=0, char c2=0, char c3=0, char c4=0)
+        : spanner_(c1, c2, c3, c4)
+    {
+    }
+
+    void reset()
+    {
+    }
+
+    size_t
+    operator()(const char *p, const char *endp)
+    {
+        size_t rc = spanner_(p);
+        if(rc != 16) {
+            return rc;
+        }
+        return 16 + spanner_(p + 16);
+    }
+};
+
+
+/**
+ * Set of up to 4 bytes for a ByteMatcher. NULs are dropped, and the remaining
+ * slots padded with duplicates so vectorized matchers can always compare
+ * against 4 values.
+ */
+struct ByteSet
+{
+    char chars_[4];
+    bool empty_;
+
+    ByteSet(char c1, char c2, char c3, char c4)
+    {
+        const char in[] = {c1, c2, c3, c4};
+        int n = 0;
+        for(char c : in) {
+            if(c) {
+                chars_[n++] = c;
+            }
+        }
+        empty_ = !n;
+        for(int i = n; i < 4; i++) {
+            chars_[i] = n ? chars_[0] : 0;
+        }
+    }
+};
+
+
+/**
+ * Callable that compares a 64 byte block against a set of up to 4 bytes,
+ * returning a bitmask with bit N set if byte N matched any of them. Unlike
+ * PCMPISTRI every occurrence is reported, not only the first, and NUL has no
+ * special meaning.
+ *
+ * The fallback compares 8 bytes at a time within 64-bit words, finding
+ * matching bytes by testing for zero bytes after XOR with each character.
+ */
+struct ByteMatcherFallback
+    : public ByteSet
+{
+    static const uint64_t kLow7 = 0x7f7f7f7f7f7f7f7fULL;
+
+    ByteMatcherFallback(char c1=0, char c2=0, char c3=0, char c4=0)
+        : ByteSet(c1, c2, c3, c4)
+    {
+    }
+
+    /**
+     * Return `x` with the high bit of each zero byte set, and all other bits
+     * clear.
+     */
+    static uint64_t
+    zero_bytes(uint64_t x)
+    {
+        return ~(((x & kLow7) + kLow7) | x | kLow7);
+    }
+
+    uint64_t
+    operator()(const char *p) const
+    {
+        if(empty_) {
+            return 0;
+        }
+
+        uint64_t mask = 0;
+        for(int j = 0; j < 8; j++) {
+            uint64_t x;
+            ::memcpy(&x, p + (8 * j), sizeof x);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            x = __builtin_bswap64(x);
+#endif
+            uint64_t m = 0;
+            for(int i = 0; i < 4; i++) {
+                m |= zero_bytes(x ^ (0x0101010101010101ULL * (uint8_t) chars_[i]));
+            }
+            // Gather the high bit of each byte into the top byte, in order.
+            mask |= (((m >> 7) * 0x0102040810204080ULL) >> 56) << (8 * j);
+        }
+        return mask;
+    }
+};
+
+
+#ifdef CSM_X86
+struct ByteMatcherSse2
+    : public ByteSet
+{
+    ByteMatcherSse2(char c1=0, char c2=0, char c3=0, char c4=0)
+        : ByteSet(c1, c2, c3, c4)
+    {
+    }
+
+    uint64_t __attribute__((__always_inline__))
+    operator()(const char *p) const
+    {
+        if(empty_) {
+            return 0;
+        }
+
+        uint64_t mask = 0;
+        for(int j = 0; j < 4; j++) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (p + (16 * j)));
+            __m128i m = _mm_setzero_si128();
+            for(int i = 0; i < 4; i++) {
+                m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(chars_[i])));
+            }
+            mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(m) << (16 * j);
+        }
+        return mask;
+    }
+};
+
+
+struct ByteMatcherAvx2
+    : public ByteSet
+{
+    ByteMatcherAvx2(char c1=0, char c2=0, char c3=0, char c4=0)
+        : ByteSet(c1, c2, c3, c4)
+    {
+    }
+
+    uint64_t CSM_ATTR_AVX2
+    operator()(const char *p) const
+    {
+        if(empty_) {
+            return 0;
+        }
+
+        __m256i lo = _mm256_loadu_si256((const __m256i *) p);
+        __m256i hi = _mm256_loadu_si256((const __m256i *) (p + 32));
+        __m256i mlo = _mm256_setzero_si256();
+        __m256i mhi = _mm256_setzero_si256();
+        for(int i = 0; i < 4; i++) {
+            __m256i v = _mm256_set1_epi8(chars_[i]);
+            mlo = _mm256_or_si256(mlo, _mm256_cmpeq_epi8(lo, v));
+            mhi = _mm256_or_si256(mhi, _mm256_cmpeq_epi8(hi, v));
+        }
+
+        return ((uint64_t) (uint32_t) _mm256_movemask_epi8(mlo)) |
+               ((uint64_t) (uint32_t) _mm256_movemask_epi8(mhi) << 32);
+    }
+};
+
+
+/**
+ * AVX-512BW compares all 64 bytes in a single register, writing results
+ * directly to a mask register, so no movemask or merging of halves is needed.
+ */
+struct ByteMatcherAvx512
+    : public ByteSet
+{
+    ByteMatcherAvx512(char c1=0, char c2=0, char c3=0, char c4=0)
+        : ByteSet(c1, c2, c3, c4)
+    {
+    }
+
+    uint64_t CSM_ATTR_AVX512BW
+    operator()(const char *p) const
+    {
+        if(empty_) {
+            return 0;
+        }
+
+        __m512i v = _mm512_loadu_si512((const void *) p);
+        __mmask64 m = 0;
+        for(int i = 0; i < 4; i++) {
+            m |= _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(chars_[i]));
+        }
+        return (uint64_t) m;
+    }
+};
+#endif // CSM_X86
+
+
+/**
+ * Spanner built from a ByteMatcher that classifies 64 bytes at a time. The
+ * most recent bitmask is cached, so when several matches fall within the same
+ * block (e.g. a run of short cells), each subsequent call merely clears the
+ * bits below the requested position and counts trailing zeros, rather than
+ * rescanning the input.
+ *
+ * Returns the index 0..63 of the first match at or after `p`, or 64 if no
+ * match was found. Bytes at or beyond `endp` are never read, so unlike
+ * StringSpanner no trailing NULs are required.
+ *
+ * The cache is keyed on address, so it must be reset() whenever the contents
+ * of the underlying buffer may have changed, i.e. after StreamCursor::fill().
+ */
+template<class Matcher>
+struct BitmaskSpanner
+{
+    static const size_t kWidth = 64;
+    Matcher matcher_;
+    uintptr_t base_;
+    uint64_t mask_;
+
+    BitmaskSpanner(char c1=0, char c2=0, char c3=0, char c4=0)
+        : matcher_(c1, c2, c3, c4)
+        , base_(0)
+        , mask_(0)
+    {
+    }
+
+    void reset()
+    {
+        base_ = 0;
+        mask_ = 0;
+    }
+
+    size_t
+    operator()(const char *p, const char *endp)
+    {
+        uintptr_t off = (uintptr_t) p - base_;
+        if(off < 64) {
+            // mask_ is left intact, since a row may be reparsed from its
+            // start after the cell array grows.
+            uint64_t mask = mask_ & (~0ULL << off);
+            if(mask) {
+                return __builtin_ctzll(mask) - off;
+            }
+        }
+
+        if(endp - p >= 64) {
+            mask_ = matcher_(p);
+        } else {
+            char tmp[64] = {0};
+            if(endp > p) {
+                memcpy(tmp, p, endp - p);
+            }
+            mask_ = matcher_(tmp);
+        }
+
+        base_ = (uintptr_t) p;
+        return mask_ ? __builtin_ctzll(mask_) : 64;
+    }
+};
+
+
+/**
+ * Return a mask where bit N is set if an odd number of bits 0..N are set in
+ * `bits`, computed with shifts.
+ */
+inline uint64_t
+prefix_xor_shift(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+
+#ifdef CSM_X86
+/**
+ * As prefix_xor_shift(), computed as a carry-less multiply by all-ones.
+ */
+inline uint64_t CSM_ATTR_PCLMUL
+prefix_xor_clmul(uint64_t bits)
+{
+    __m128i v = _mm_set_epi64x(0, (int64_t) bits);
+    __m128i ones = _mm_set1_epi8(-1);
+    return (uint64_t) _mm_cvtsi128_si64(_mm_clmulepi64_si128(v, ones, 0));
+}
+#endif // CSM_X86
+
+
+/*
+ * Kernels bundle the primitives used by CsvReader::try_parse() and
+ * StructuralIndex::build() for one instruction set. Functions specialized on
+ * a kernel are only ever called from wrappers carrying the matching target
+ * attribute and `flatten`, so its primitives are inlined there.
+ */
+
+struct FallbackKernel
+{
+    using CellSpanner = PairedSpanner<StringSpannerFallback>;
+    using ByteMatcher = ByteMatcherFallback;
+
+    static uint64_t
+    prefix_xor(uint64_t bits)
+    {
+        return prefix_xor_shift(bits);
+    }
+};
+
+
+#ifdef CSM_X86
+struct Sse42Kernel
+{
+    using CellSpanner = PairedSpanner<StringSpannerSse42>;
+    using ByteMatcher = ByteMatcherSse2;
+
+    static uint64_t
+    prefix_xor(uint64_t bits)
+    {
+        return prefix_xor_shift(bits);
+    }
+};
+
+
+struct Avx2Kernel
+{
+    using CellSpanner = BitmaskSpanner<ByteMatcherAvx2>;
+    using ByteMatcher = ByteMatcherAvx2;
+
+    static uint64_t CSM_ATTR_PCLMUL
+    prefix_xor(uint64_t bits)
+    {
+        return prefix_xor_clmul(bits);
+    }
+};
+
+
+struct Avx512Kernel
+{
+    using CellSpanner = BitmaskSpanner<ByteMatcherAvx512>;
+    using ByteMatcher = ByteMatcherAvx512;
+
+    static uint64_t CSM_ATTR_PCLMUL
+    prefix_xor(uint64_t bits)
+    {
+        return prefix_xor_clmul(bits);
+    }
+};
+#endif // CSM_X86
+
+
+/**
+ * Given a bitmask of quote characters in a 64 byte block, return a mask with
+ * bits set for every byte from an opening quote up to but excluding its
+ * closing quote. `state` is all-ones if the previous block ended inside
+ * quotes, and is updated for the following block.
+ *
+ * Since a doubled quote toggles the state twice, escaped quotes need no
+ * special handling, and the mask is produced without branching.
+ */
+template<class Kernel>
+inline uint64_t
+quote_regions(uint64_t quotes, uint64_t &state)
+{
+    uint64_t regions = Kernel::prefix_xor(quotes) ^ state;
+    state = (uint64_t) ((int64_t) regions >> 63);
+    return regions;
+}
+
+
+/**
+ * Finds the end of a record using quote parity, examining 64 bytes per step
+ * regardless of how many fields they contain. Used by CsvReader::try_parse()
+ * to skip the remainder of a record following the last projected column.
+ *
+ * As with StructuralIndex, quotes may only appear around entire fields.
+ * Escape characters are unsupported.
+ */
+template<class Kernel>
+struct RecordSkipper
+{
+    typename Kernel::ByteMatcher quote_matcher_;
+    typename Kernel::ByteMatcher newline_matcher_;
+
+    RecordSkipper(char quotechar)
+        : quote_matcher_(quotechar)
+        , newline_matcher_('\r', '\n')
+    {
+    }
+
+    /**
+     * Return the offset from `p`, which must be positioned outside of
+     * quotes, of the first CR or LF appearing outside of quotes, or
+     * `endp - p` if the record does not end before `endp`.
+     */
+    size_t
+    operator()(const char *p, const char *endp) const
+    {
+        uint64_t state = 0;
+        for(const char *block = p; block < endp; block += 64) {
+            const char *q = block;
+            char tmp[64];
+            if(endp - block < 64) {
+                ::memset(tmp, 0, sizeof tmp);
+                ::memcpy(tmp, block, endp - block);
+                q = tmp;
+            }
+
+            uint64_t newlines = newline_matcher_(q);
+            newlines &= ~quote_regions<Kernel>(quote_matcher_(q), state);
+            if(newlines) {
+                return (block - p) + __builtin_ctzll(newlines);
+            }
+        }
+        return endp - p;
+    }
+};
+
+
+/**
+ * Without vector instructions, building masks costs more than simply walking
+ * the bytes while tracking quote state.
+ */
+template<>
+struct RecordSkipper<FallbackKernel>
+{
+    char quotechar_;
+
+    RecordSkipper(char quotechar)
+        : quotechar_(quotechar)
+    {
+    }
+
+    size_t
+    operator()(const char *p, const char *endp) const
+    {
+        bool quoted = false;
+        for(const char *q = p; q < endp; q++) {
+            if(*q == quotechar_) {
+                quoted = !quoted;
+            } else if((*q == '\r' || *q == '\n') && !quoted) {
+                return q - p;
+            }
+        }
+        return endp - p;
+    }
+};
+
+
+/**
+ * Stage one of two-stage parsing. Records the offset of every delimiter and
+ * newline appearing outside of quotes within a block of input, without
+ * otherwise interpreting it. CsvReader then produces rows by slicing the
+ * index, rather than running its state machine over every byte.
+ *
+ * Quote state is derived purely from quote parity, so quotes may only appear
+ * around entire fields, as in RFC 4180. Escape characters are unsupported.
+ */
+class StructuralIndex
+{
+    char delimiter_;
+    char quotechar_;
+    CsmKernel kernel_;
+    size_t (StructuralIndex::*build_)(const char *p, size_t size);
+    size_t (StructuralIndex::*count_quotes_)(const char *p, size_t size) const;
+
+    template<class Kernel>
+    size_t
+    build_kernel(const char *p, size_t size)
+    {
+        typename Kernel::ByteMatcher quote_matcher(quotechar_);
+        typename Kernel::ByteMatcher delimiter_matcher(delimiter_);
+        typename Kernel::ByteMatcher newline_matcher('\r', '\n');
+
+        uint32_t *out = &offsets[0];
+        uint64_t state = 0;
+        for(size_t o = 0; o < size; o += 64) {
+            const char *block = p + o;
+            char tmp[64];
+            if(size - o < 64) {
+                ::memset(tmp, 0, sizeof tmp);
+                ::memcpy(tmp, block, size - o);
+                block = tmp;
+            }
+
+            uint64_t structurals = delimiter_matcher(block)
+                                 | newline_matcher(block);
+            uint64_t quotes = quote_matcher(block);
+            structurals &= ~quote_regions<Kernel>(quotes, state);
+            while(structurals) {
+                *out++ = (uint32_t) (o + __builtin_ctzll(structurals));
+                structurals &= structurals - 1;
+            }
+        }
+
+        return out - &offsets[0];
+    }
+
+    template<class Kernel>
+    size_t
+    count_quotes_kernel(const char *p, size_t size) const
+    {
+        typename Kernel::ByteMatcher quote_matcher(quotechar_);
+
+        size_t n = 0;
+        size_t o = 0;
+        for(; (o + 64) <= size; o += 64) {
+            n += __builtin_popcountll(quote_matcher(p + o));
+        }
+        if(o < size) {
+            char tmp[64] = {0};
+            ::memcpy(tmp, p + o, size - o);
+            n += __builtin_popcountll(quote_matcher(tmp));
+        }
+        return n;
+    }
+
+    size_t __attribute__((flatten))
+    build_fallback(const char *p, size_t size)
+    {
+        return build_kernel<FallbackKernel>(p, size);
+    }
+
+    size_t __attribute__((flatten))
+    count_quotes_fallback(const char *p, size_t size) const
+    {
+        return count_quotes_kernel<FallbackKernel>(p, size);
+    }
+
+#ifdef CSM_X86
+    size_t __attribute__((target("sse4.2"), flatten))
+    build_sse42(const char *p, size_t size)
+    {
+        return build_kernel<Sse42Kernel>(p, size);
+    }
+
+    size_t __attribute__((target("sse4.2"), flatten))
+    count_quotes_sse42(const char *p, size_t size) const
+    {
+        return count_quotes_kernel<Sse42Kernel>(p, size);
+    }
+
+    size_t __attribute__((target("avx2,pclmul"), flatten))
+    build_avx2(const char *p, size_t size)
+    {
+        return build_kernel<Avx2Kernel>(p, size);
+    }
+
+    size_t __attribute__((target("avx2"), flatten))
+    count_quotes_avx2(const char *p, size_t size) const
+    {
+        return count_quotes_kernel<Avx2Kernel>(p, size);
+    }
+
+    size_t __attribute__((target("avx512bw,pclmul"), flatten))
+    build_avx512(const char *p, size_t size)
+    {
+        return build_kernel<Avx512Kernel>(p, size);
+    }
+
+    size_t __attribute__((target("avx512bw"), flatten))
+    count_quotes_avx512(const char *p, size_t size) const
+    {
+        return count_quotes_kernel<Avx512Kernel>(p, size);
+    }
+#endif // CSM_X86
+
+    public:
+    static const size_t kBlockSize = 1 << 20;
+
+    const char *base;
+    size_t size;
+    std::vector<uint32_t> offsets;
+    size_t count;
+
+    StructuralIndex(char delimiter=',', char quotechar='"',
+                    CsmKernel kernel=kCsmKernelAuto)
+        : delimiter_(delimiter)
+        , quotechar_(quotechar)
+        , base(0)
+        , size(0)
+        , offsets()
+        , count(0)
+    {
+        set_kernel(kernel);
+    }
+
+    CsmKernel
+    kernel() const
+    {
+        return kernel_;
+    }
+
+    /**
+     * Select the kernel used by build(). Throws csvmonkey::Error if the
+     * running CPU does not support it.
+     */
+    void
+    set_kernel(CsmKernel kernel)
+    {
+        if(! kernel_supported(kernel)) {
+            throw Error("set_kernel", "kernel unsupported by this CPU");
+        }
+
+        kernel_ = resolve_kernel(kernel);
+        switch(kernel_) {
+#ifdef CSM_X86
+        case kCsmKernelSse42:
+            build_ = &StructuralIndex::build_sse42;
+            count_quotes_ = &StructuralIndex::count_quotes_sse42;
+            break;
+        case kCsmKernelAvx2:
+            build_ = &StructuralIndex::build_avx2;
+            count_quotes_ = &StructuralIndex::count_quotes_avx2;
+            break;
+        case kCsmKernelAvx512:
+            build_ = &StructuralIndex::build_avx512;
+            count_quotes_ = &StructuralIndex::count_quotes_avx512;
+            break;
+#endif
+        default:
+            build_ = &StructuralIndex::build_fallback;
+            count_quotes_ = &StructuralIndex::count_quotes_fallback;
+        }
+    }
+
+    void
+    clear()
+    {
+        base = 0;
+        size = 0;
+        count = 0;
+    }
+
+    /**
+     * Index `size` bytes starting at `p`, which must be positioned outside
+     * of quotes, i.e. at the start of a record.
+     */
+    void
+    build(const char *p, size_t size)
+    {
+        if(offsets.size() < size + 1) {
+            offsets.resize(size + 1);
+        }
+
+        base = p;
+        this->size = size;
+        count = (this->*build_)(p, size);
+    }
+
+    /**
+     * Return the number of quote characters in `size` bytes at `p`, used to
+     * find the quote state at an arbitrary offset without indexing.
+     */
+    size_t
+    count_quotes(const char *p, size_t size) const
+    {
+        return (this->*count_quotes_)(p, size);
+    }
+};
+
+
+/**
+ * Counts records, or finds the offset at which each begins, by classifying
+ * 64 bytes at a time using quote parity, without otherwise parsing them.
+ * Records are counted as by CsvReader::read_row(), so blank lines are
+ * ignored. A final record lacking a newline is only counted if
+ * `yield_incomplete_row` is true.
+ *
+ * As with StructuralIndex, quotes may only appear around entire fields.
+ * Escape characters are unsupported.
+ */
+class RowIndexer
+{
+    char quotechar_;
+    bool yield_incomplete_row_;
+    CsmKernel kernel_;
+    size_t (RowIndexer::*scan_)(const char *p, size_t size,
+                                std::vector<uint64_t> *offsets,
+                                size_t stride, size_t limit) const;
+
+    /**
+     * Count records in `size` bytes at `p`. If `offsets` is not null, append
+     * the offset of every `stride`th record to it, stopping early once it
+     * holds `limit` offsets and the last of them is known to be a record.
+     */
+    template<class Kernel>
+    size_t
+    scan_kernel(const char *p, size_t size, std::vector<uint64_t> *offsets,
+                size_t stride, size_t limit) const
+    {
+        typename Kernel::ByteMatcher quote_matcher(quotechar_);
+        typename Kernel::ByteMatcher newline_matcher('\r', '\n');
+
+        size_t count = 0;
+        uint64_t state = 0;
+        // Treat the start of input as following a newline.
+        uint64_t after_newline = 1;
+        // True if the last record seen has not yet ended.
+        bool open = false;
+        // Number of the next record whose offset is wanted.
+        size_t sample = 0;
+        // True if `limit` was reached at a record whose end is not yet seen.
+        bool pending = false;
+
+        for(size_t o = 0; o < size; o += 64) {
+            const char *block = p + o;
+            uint64_t valid = ~0ULL;
+            char tmp[64];
+            if(size - o < 64) {
+                ::memset(tmp, 0, sizeof tmp);
+                ::memcpy(tmp, block, size - o);
+                block = tmp;
+                valid >>= 64 - (size - o);
+            }
+
+            uint64_t newlines = newline_matcher(block);
+            newlines &= ~quote_regions<Kernel>(quote_matcher(block), state);
+            newlines &= valid;
+            if(pending) {
+                if(newlines) {
+                    return count;
+                }
+                continue;
+            }
+
+            uint64_t starts = ((newlines << 1) | after_newline)
+                            & ~newlines & valid;
+            after_newline = newlines >> 63;
+
+            if(starts | newlines) {
+                int last_start = starts ? 63 - __builtin_clzll(starts) : -1;
+                int last_end = newlines ? 63 - __builtin_clzll(newlines) : -1;
+                open = last_start > last_end;
+            }
+
+            size_t n = __builtin_popcountll(starts);
+            if(offsets && (count + n) > sample) {
+                for(; starts; starts &= starts - 1, count++) {
+                    if(count == sample) {
+                        int bit = __builtin_ctzll(starts);
+                        offsets->push_back(o + bit);
+                        if(offsets->size() == limit) {
+                            // A final record lacking a newline may not count.
+                            if(yield_incomplete_row_ || (newlines >> bit)) {
+                                return count + 1;
+                            }
+                            pending = true;
+                            count++;
+                            break;
+                        }
+                        sample += stride;
+                    }
+                }
+            } else {
+                count += n;
+            }
+        }
+
+        if(pending) {
+            offsets->pop_back();
+            return count - 1;
+        }
+        if(open && ! yield_incomplete_row_) {
+            count--;
+            if(offsets && sample == (count + stride)) {
+                offsets->pop_back();
+            }
+        }
+        return count;
+    }
+
+    size_t __attribute__((flatten))
+    scan_fallback(const char *p, size_t size, std::vector<uint64_t> *offsets,
+                  size_t stride, size_t limit) const
+    {
+        return scan_kernel<FallbackKernel>(p, size, offsets, stride, limit);
+    }
+
+#ifdef CSM_X86
+    size_t __attribute__((target("sse4.2"), flatten))
+    scan_sse42(const char *p, size_t size, std::vector<uint64_t> *offsets,
+               size_t stride, size_t limit) const
+    {
+        return scan_kernel<Sse42Kernel>(p, size, offsets, stride, limit);
+    }
+
+    size_t __attribute__((target("avx2,pclmul"), flatten))
+    scan_avx2(const char *p, size_t size, std::vector<uint64_t> *offsets,
+              size_t stride, size_t limit) const
+    {
+        return scan_kernel<Avx2Kernel>(p, size, offsets, stride, limit);
+    }
+
+    size_t __attribute__((target("avx512bw,pclmul"), flatten))
+    scan_avx512(const char *p, size_t size, std::vector<uint64_t> *offsets,
+                size_t stride, size_t limit) const
+    {
+        return scan_kernel<Avx512Kernel>(p, size, offsets, stride, limit);
+    }
+#endif // CSM_X86
+
+    public:
+    RowIndexer(char quotechar='"', bool yield_incomplete_row=false,
+               CsmKernel kernel=kCsmKernelAuto)
+        : quotechar_(quotechar)
+        , yield_incomplete_row_(yield_incomplete_row)
+    {
+        set_kernel(kernel);
+    }
+
+    CsmKernel
+    kernel() const
+    {
+        return kernel_;
+    }
+
+    /**
+     * Select the kernel used for scanning. Throws csvmonkey::Error if the
+     * running CPU does not support it.
+     */
+    void
+    set_kernel(CsmKernel kernel)
+    {
+        if(! kernel_supported(kernel)) {
+            throw Error("set_kernel", "kernel unsupported by this CPU");
+        }
+
+        kernel_ = resolve_kernel(kernel);
+        switch(kernel_) {
+#ifdef CSM_X86
+        case kCsmKernelSse42:
+            scan_ = &RowIndexer::scan_sse42;
+            break;
+        case kCsmKernelAvx2:
+            scan_ = &RowIndexer::scan_avx2;
+            break;
+        case kCsmKernelAvx512:
+            scan_ = &RowIndexer::scan_avx512;
+            break;
+#endif
+        default:
+            scan_ = &RowIndexer::scan_fallback;
+        }
+    }
+
+    /**
+     * Return the number of records in `size` bytes at `p`, which must be
+     * positioned outside of quotes.
+     */
+    size_t
+    count(const char *p, size_t size) const
+    {
+        return (this->*scan_)(p, size, 0, 1, 0);
+    }
+
+    /**
+     * Append the offset relative to `p` of every `stride`th record in `size`
+     * bytes at `p` to `offsets`, starting with the first. Return the total
+     * number of records.
+     */
+    size_t
+    index(const char *p, size_t size, std::vector<uint64_t> &offsets,
+          size_t stride=1) const
+    {
+        return (this->*scan_)(p, size, &offsets, std::max((size_t) 1, stride),
+                              ~(size_t) 0);
+    }
+
+    /**
+     * Return the offset relative to `p` of record `n` within `size` bytes
+     * at `p`, or `size` if fewer records exist. Scanning stops at the end of
+     * the record.
+     */
+    size_t
+    find(const char *p, size_t size, size_t n) const
+    {
+        std::vector<uint64_t> offsets;
+        size_t want = n ? 2 : 1;
+        (this->*scan_)(p, size, &offsets, std::max((size_t) 1, n), want);
+        return (offsets.size() == want) ? offsets.back() : size;
+    }
+};
+
+
+/**
+ * Return the number of records remaining in `stream`, without consuming them.
+ */
+inline size_t
+count_rows(MappedFileCursor &stream, char quotechar='"',
+           bool yield_incomplete_row=false)
+{
+    RowIndexer indexer(quotechar, yield_incomplete_row);
+    return indexer.count(stream.buf(), stream.size());
+}
+
+
+/**
+ * Return the offset relative to stream.buf() at which each record remaining
+ * in `stream` begins, without consuming them.
+ */
+inline std::vector<uint64_t>
+build_row_index(MappedFileCursor &stream, char quotechar='"',
+                bool yield_incomplete_row=false)
+{
+    std::vector<uint64_t> offsets;
+    RowIndexer indexer(quotechar, yield_incomplete_row);
+    indexer.index(stream.buf(), stream.size(), offsets);
+    return offsets;
+}
+
+/**
+ * Return an FNV-1a hash of the size of `stream`, and its first and last
+ * 64 KiB, used to detect modification of an input described by a sidecar
+ * file without reading all of it.
+ */
+inline uint64_t
+fingerprint(MappedFileCursor &stream)
+{
+    static const size_t kSampleBytes = 1 << 16;
+
+    uint64_t size = stream.file_size();
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto update = [&](const char *p, size_t n) {
+        for(size_t i = 0; i < n; i++) {
+            h = (h ^ (uint8_t) p[i]) * 0x100000001b3ULL;
+        }
+    };
+
+    update((const char *) &size, sizeof size);
+    size_t n = std::min((size_t) size, kSampleBytes);
+    update(stream.startp(), n);
+    update(stream.startp() + size - n, n);
+    return h;
+}
+
+
+/**
+ * Sampled record offsets for a MappedFileCursor, allowing CsvReader to seek
+ * to any record by scanning at most `stride` records from the nearest
+ * sample. Indices are built with RowIndexer, so share its restrictions, and
+ * may be saved to a sidecar file to avoid rescanning the input.
+ *
+ * A saved index records the input's size, modification time and
+ * fingerprint(), and is only loaded if they match.
+ */
+class RowOffsetIndex
+{
+    static const uint64_t kVersion = 1;
+
+    struct Header
+    {
+        char magic[8];
+        uint64_t version;
+        uint64_t file_size;
+        int64_t mtime_ns;
+        uint64_t hash;
+        uint64_t stride;
+        uint64_t rows;
+        uint64_t samples;
+        char quotechar;
+        char yield_incomplete_row;
+        char pad[6];
+    };
+
+    RowIndexer indexer_;
+    char quotechar_;
+    bool yield_incomplete_row_;
+    uint64_t file_size_;
+    int64_t mtime_ns_;
+    uint64_t hash_;
+    size_t stride_;
+    size_t rows_;
+    std::vector<uint64_t> offsets_;
+
+    public:
+    static const size_t kDefaultStride = 4096;
+
+    RowOffsetIndex(char quotechar='"', bool yield_incomplete_row=false)
+        : indexer_(quotechar, yield_incomplete_row)
+        , quotechar_(quotechar)
+        , yield_incomplete_row_(yield_incomplete_row)
+        , file_size_(0)
+        , mtime_ns_(0)
+        , hash_(0)
+        , stride_(kDefaultStride)
+        , rows_(0)
+        , offsets_()
+    {
+    }
+
+    /**
+     * Return the sidecar path conventionally used for `path`.
+     */
+    static std::string
+    sidecar_path(const std::string &path)
+    {
+        return path + ".csmidx";
+    }
+
+    /**
+     * Index every record of `stream`, regardless of its current position,
+     * sampling the offset of every `stride`th record.
+     */
+    void
+    build(MappedFileCursor &stream, size_t stride=kDefaultStride)
+    {
+        stride_ = std::max((size_t) 1, stride);
+        offsets_.clear();
+        rows_ = indexer_.index(stream.startp(), stream.file_size(), offsets_,
+                               stride_);
+        file_size_ = stream.file_size();
+        mtime_ns_ = stream.mtime_ns();
+        hash_ = fingerprint(stream);
+    }
+
+    /**
+     * Write the index to `path`. Throws csvmonkey::Error on failure.
+     */
+    void
+    save(const std::string &path) const
+    {
+        Header header;
+        ::memset(&header, 0, sizeof header);
+        ::memcpy(header.magic, "CSMIDX", sizeof "CSMIDX");
+        header.version = kVersion;
+        header.file_size = file_size_;
+        header.mtime_ns = mtime_ns_;
+        header.hash = hash_;
+        header.stride = stride_;
+        header.rows = rows_;
+        header.samples = offsets_.size();
+        header.quotechar = quotechar_;
+        header.yield_incomplete_row = yield_incomplete_row_;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write((const char *) &header, sizeof header);
+        out.write((const char *) offsets_.data(),
+                  offsets_.size() * sizeof offsets_[0]);
+        out.close();
+        if(! out) {
+            throw Error(path.c_str(), "could not write index");
+        }
+    }
+
+    /**
+     * Load an index for `stream` from `path`. Return false if `path` does
+     * not exist, is truncated, or describes a different version of the input
+     * or different parsing options, in which case build() should be used. Throws
+     * csvmonkey::Error if `path` is not a valid index.
+     */
+    bool
+    load(const std::string &path, MappedFileCursor &stream)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if(! in) {
+            return false;
+        }
+
+        Header header;
+        if((! in.read((char *) &header, sizeof header)) ||
+                ::memcmp(header.magic, "CSMIDX", sizeof "CSMIDX") ||
+                header.version != kVersion) {
+            throw Error(path.c_str(), "not a csvmonkey index");
+        }
+
+        if(header.file_size != stream.file_size() ||
+                header.mtime_ns != stream.mtime_ns() ||
+                header.quotechar != quotechar_ ||
+                (bool) header.yield_incomplete_row != yield_incomplete_row_ ||
+                header.hash != fingerprint(stream)) {
+            return false;
+        }
+
+        // A truncated or corrupt sidecar may still match the fingerprint.
+        std::streamoff pos = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff remaining = in.tellg() - pos;
+        in.seekg(pos);
+        if(header.samples > ((uint64_t) remaining / sizeof(uint64_t))) {
+            return false;
+        }
+
+        std::vector<uint64_t> offsets(header.samples);
+        if(! in.read((char *) offsets.data(),
+                     offsets.size() * sizeof offsets[0])) {
+            throw Error(path.c_str(), "truncated index");
+        }
+
+        file_size_ = header.file_size;
+        mtime_ns_ = header.mtime_ns;
+        hash_ = header.hash;
+        stride_ = std::max((uint64_t) 1, header.stride);
+        rows_ = header.rows;
+        offsets_.swap(offsets);
+        return true;
+    }
+
+    /**
+     * Return the number of records in the input.
+     */
+    size_t
+    rows() const
+    {
+        return rows_;
+    }
+
+    size_t
+    stride() const
+    {
+        return stride_;
+    }
+
+    /**
+     * Find the offset of record `n` within `stream`, scanning forward from
+     * the nearest sample. Return false if `n` is beyond the last record.
+     */
+    bool
+    record_offset(MappedFileCursor &stream, size_t n, uint64_t &offset) const
+    {
+        if(n >= rows_ || (n / stride_) >= offsets_.size()) {
+            return false;
+        }
+
+        uint64_t base = offsets_[n / stride_];
+        size_t size = stream.file_size() - std::min(base, (uint64_t) stream.file_size());
+        offset = base + indexer_.find(stream.startp() + base, size,
+                                      n % stride_);
+        return true;
+    }
+};
+
+
+class CsvCursor
+{
+    public:
+    std::vector<CsvCell> cells;
+    size_t count;
+
+    CsvCursor()
+        : cells()
+        , count(0)
+    {
+    }
+
+    bool
+    by_value(const std::string &value, CsvCell *&cell)
+    {
+        for(size_t i = 0; i < count; i++) {
+            if(value == cells[i].as_str()) {
+                cell = &cells[i];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+/**
+ * Spanners used by CsvReader::try_parse() for quoted and unquoted cells, and
+ * for skipping the remainder of a record.
+ */
+template<class Kernel>
+struct CellSpanners
+{
+    typename Kernel::CellSpanner quoted;
+    typename Kernel::CellSpanner unquoted;
+    RecordSkipper<Kernel> record;
+
+    CellSpanners(char delimiter, char quotechar, char escapechar)
+        : quoted(quotechar, escapechar)
+        , unquoted(delimiter, '\r', '\n', escapechar)
+        , record(quotechar)
+    {
+    }
+
+    void
+    reset()
+    {
+        quoted.reset();
+        unquoted.reset();
+    }
+};
+
+
+template<class StreamCursorType>
+class alignas(16) CsvReader
+{
+    const char *endp_;
+    const char *p_;
+    char delimiter_;
+    char quotechar_;
+    char escapechar_;
+    bool yield_incomplete_row_;
+
+    public:
+    bool in_newline_skip;
+
+    private:
+    StreamCursorType &stream_;
+    CsmKernel kernel_;
+    CellSpanners<FallbackKernel> fallback_spanners_;
+#ifdef CSM_X86
+    CellSpanners<Sse42Kernel> sse42_spanners_;
+    CellSpanners<Avx2Kernel> avx2_spanners_;
+    CellSpanners<Avx512Kernel> avx512_spanners_;
+#endif
+    CsvCursor row_;
+
+    /// Nonzero for each projected column; empty if not projecting.
+    std::vector<uint8_t> projection_;
+    /// Count of cells produced per row when projecting, otherwise 0.
+    size_t projection_end_;
+    /// Written in place of cells for columns not projected.
+    CsvCell skip_cell_;
+
+    bool two_stage_;
+    StructuralIndex index_;
+    size_t index_pos_;
+    size_t index_window_;
+
+    enum CsmTryParseReturnType {
+        kCsmTryParseOkay,
+        kCsmTryParseOverflow,
+        kCsmTryParseUnderrun
+    };
+
+    CsmTryParseReturnType (CsvReader::*try_parse_)();
+
+    /**
+     * Return the cell to write for the column following those already in
+     * row_, when projecting.
+     */
+    CsvCell *
+    projected_cell()
+    {
+        return projection_[row_.count] ? &row_.cells[row_.count] : &skip_cell_;
+    }
+
+    /**
+     * Parse one row from p_..endp_. When `Project` is true, only columns
+     * selected by set_columns() are written to row_, and the remainder of the
+     * record is skipped once the last of them is parsed.
+     */
+    template<bool Project, class Kernel>
+    CsmTryParseReturnType
+    try_parse(CellSpanners<Kernel> &spanners)
+    {
+        typedef typename Kernel::CellSpanner Spanner;
+        const char *p = p_;
+        const char *cell_start;
+        size_t rc;
+
+        row_.count = 0;
+        CsvCell *cell = Project ? projected_cell() : &row_.cells[0];
+
+        #define PREAMBLE() \
+            if(p >= endp_) {\
+                CSM_DEBUG("pos exceeds size"); \
+                return kCsmTryParseUnderrun; \
+            } \
+            CSM_DEBUG("p = %#p; remain = %ld; next char is: %d", p, endp_-p, (int)*p) \
+            CSM_DEBUG("%d: distance to next newline: %d", __LINE__, strchr(p, '\n') - p);
+
+        #define NEXT_CELL() \
+            if(Project) { \
+                if(row_.count == projection_end_) { \
+                    ++p; \
+                    goto skip_record; \
+                } \
+                cell = projected_cell(); \
+            } else { \
+                ++cell; \
+                if(row_.count == row_.cells.size()) { \
+                    CSM_DEBUG("cell array overflow"); \
+                    return kCsmTryParseOverflow; \
+                } \
+            }
+
+        CSM_DEBUG("remain = %lu", endp_ - p);
+        CSM_DEBUG("ch = %d %c", (int) *p, *p);
+
+    newline_skip:
+        /*
+         * Skip newlines appearing at the start of the line, which may be a
+         * result of DOS/MAC-formatted input. Or a double-spaced CSV file.
+         */
+        in_newline_skip = true;
+        PREAMBLE()
+        if(*p == '\r' || *p == '\n') {
+            ++p;
+            goto newline_skip;
+        }
+
+    cell_start:
+        in_newline_skip = false;
+        PREAMBLE()
+        cell->escaped = false;
+        if(*p == '\r' || *p == '\n') {
+            /*
+             * A newline appearing after at least one cell has been read
+             * indicates the presence of a single comma demarcating an unquoted
+             * unquoted unquoted unquoted empty final field.
+             */
+            cell->ptr = 0;
+            cell->size = 0;
+            ++row_.count;
+            p_ = p + 1;
+            return kCsmTryParseOkay;
+        } else if(*p == quotechar_) {
+            cell_start = ++p;
+            goto in_quoted_cell;
+        } else {
+            cell_start = p;
+            goto in_unquoted_cell;
+        }
+
+    in_quoted_cell:
+        PREAMBLE()
+        rc = spanners.quoted(p, endp_);
+        if(rc == Spanner::kWidth) {
+            p += Spanner::kWidth;
+            goto in_quoted_cell;
+        }
+
+        p += rc + 1;
+        goto in_escape_or_end_of_quoted_cell;
+
+    in_escape_or_end_of_quoted_cell:
+        PREAMBLE()
+        if(*p == delimiter_) {
+            cell->ptr = cell_start;
+            cell->size = p - cell_start - 1;
+            ++row_.count;
+            NEXT_CELL();
+            ++p;
+            goto cell_start;
+        } else if(*p == '\r' || *p == '\n') {
+            cell->ptr = cell_start;
+            cell->size = p - cell_start - 1;
+            ++row_.count;
+            p_ = p + 1;
+            return kCsmTryParseOkay;
+        } else {
+            cell->escaped = true;
+            ++p;
+            goto in_quoted_cell;
+        }
+
+    in_unquoted_cell:
+        CSM_DEBUG("\n\nin_unquoted_cell")
+        PREAMBLE()
+        rc = spanners.unquoted(p, endp_);
+        CSM_DEBUG("unquoted span: %d; p[3]=%d p[..17]='%.17s'", (int)rc, p[3], p);
+        if(rc == Spanner::kWidth) {
+            p += Spanner::kWidth;
+            goto in_unquoted_cell;
+        }
+
+        p += rc;
+        goto in_escape_or_end_of_unquoted_cell;
+
+    in_escape_or_end_of_unquoted_cell:
+        PREAMBLE()
+        if(*p == delimiter_) {
+            cell->ptr = cell_start;
+            cell->size = p - cell_start;
+            ++row_.count;
+            CSM_DEBUG("in_escape_or_end_of_unquoted_cell(DELIMITER)")
+            CSM_DEBUG("p[..17] = '%.17s'", p)
+            CSM_DEBUG("done cell: '%.*s'", (int)cell->size, cell->ptr)
+            NEXT_CELL();
+            ++p;
+            goto cell_start;
+        } else if(*p == '\r' || *p == '\n') {
+            CSM_DEBUG("in_escape_or_end_of_unquoted_cell(NEWLINE)")
+            cell->ptr = cell_start;
+            cell->size = p - cell_start;
+            ++row_.count;
+            p_ = p + 1;
+            return kCsmTryParseOkay;
+        } else {
+            cell->escaped = true;
+            ++p;
+            goto in_unquoted_cell;
+        }
+
+    /*
+     * The remaining states consume the rest of a record following the last
+     * projected column, without recording its cells. Unless an escape
+     * character is configured, the record's end is found directly from quote
+     * parity, rather than visiting each remaining cell.
+     */
+    skip_record:
+        if(escapechar_) {
+            goto skip_cell_start;
+        }
+        rc = spanners.record(p, endp_);
+        if(p + rc >= endp_) {
+            CSM_DEBUG("record end not found");
+            return kCsmTryParseUnderrun;
+        }
+        p_ = p + rc + 1;
+        return kCsmTryParseOkay;
+
+    skip_cell_start:
+        PREAMBLE()
+        if(*p == '\r' || *p == '\n') {
+            p_ = p + 1;
+            return kCsmTryParseOkay;
+        } else if(*p == quotechar_) {
+            ++p;
+            goto skip_quoted_cell;
+        }
+        goto skip_unquoted_cell;
+
+    skip_quoted_cell:
+        PREAMBLE()
+        rc = spanners.quoted(p, endp_);
+        if(rc == Spanner::kWidth) {
+            p += Spanner::kWidth;
+            goto skip_quoted_cell;
+        }
+
+        p += rc + 1;
+        PREAMBLE()
+        if(*p == delimiter_) {
+            ++p;
+            goto skip_cell_start;
+        } else if(*p == '\r' || *p == '\n') {
+            p_ = p + 1;
+            return kCsmTryParseOkay;
+        }
+        ++p;
+        goto skip_quoted_cell;
+
+    skip_unquoted_cell:
+        PREAMBLE()
+        rc = spanners.unquoted(p, endp_);
+        if(rc == Spanner::kWidth) {
+            p += Spanner::kWidth;
+            goto skip_unquoted_cell;
+        }
+
+        p += rc;
+        PREAMBLE()
+        if(*p == delimiter_) {
+            ++p;
+            goto skip_cell_start;
+        } else if(*p == '\r' || *p == '\n') {
+            p_ = p + 1;
+            return kCsmTryParseOkay;
+        }
+        ++p;
+        goto skip_unquoted_cell;
+    }
+
+    #undef PREAMBLE
+    #undef NEXT_CELL
+
+    template<bool Project>
+    CsmTryParseReturnType __attribute__((flatten))
+    try_parse_fallback()
+    {
+        return try_parse<Project>(fallback_spanners_);
+    }
+
+#ifdef CSM_X86
+    template<bool Project>
+    CsmTryParseReturnType __attribute__((target("sse4.2"), flatten))
+    try_parse_sse42()
+    {
+        return try_parse<Project>(sse42_spanners_);
+    }
+
+    template<bool Project>
+    CsmTryParseReturnType __attribute__((target("avx2,pclmul"), flatten))
+    try_parse_avx2()
+    {
+        return try_parse<Project>(avx2_spanners_);
+    }
+
+    template<bool Project>
+    CsmTryParseReturnType __attribute__((target("avx512bw,pclmul"), flatten))
+    try_parse_avx512()
+    {
+        return try_parse<Project>(avx512_spanners_);
+    }
+#endif // CSM_X86
+
+    template<bool Project>
+    void
+    select_try_parse()
+    {
+        switch(kernel_) {
+#ifdef CSM_X86
+        case kCsmKernelSse42:
+            try_parse_ = &CsvReader::try_parse_sse42<Project>;
+            break;
+        case kCsmKernelAvx2:
+            try_parse_ = &CsvReader::try_parse_avx2<Project>;
+            break;
+        case kCsmKernelAvx512:
+            try_parse_ = &CsvReader::try_parse_avx512<Project>;
+            break;
+#endif
+        default:
+            try_parse_ = &CsvReader::try_parse_fallback<Project>;
+        }
+    }
+
+    void
+    set_cell(CsvCell *cell, const char *start, const char *end)
+    {
+        if(start < end && *start == quotechar_) {
+            cell->ptr = start + 1;
+            cell->size = (end - start >= 2) ? (end - start - 2) : 0;
+            cell->escaped = !!::memchr(cell->ptr, quotechar_, cell->size);
+        } else {
+            cell->ptr = start;
+            cell->size = end - start;
+            cell->escaped = false;
+        }
+    }
+
+    /**
+     * Stage two of two-stage parsing: produce a row from the range of
+     * p_..endp_ by slicing the structural index, building the index first if
+     * p_ is not covered by it. The return values have the same meaning as for
+     * try_parse().
+     */
+    CsmTryParseReturnType
+    try_parse_indexed()
+    {
+        const char *p = p_;
+        row_.count = 0;
+
+    check_index:
+        if(p < index_.base || p >= (index_.base + index_.size)) {
+            if(p >= endp_) {
+                in_newline_skip = true;
+                return kCsmTryParseUnderrun;
+            }
+            index_window_ = StructuralIndex::kBlockSize;
+            build_index(p);
+        }
+
+        const char *base = index_.base;
+        const char *index_endp = base + index_.size;
+
+        in_newline_skip = true;
+        while(*p == '\r' || *p == '\n') {
+            if(++p == index_endp) {
+                goto check_index;
+            }
+        }
+        in_newline_skip = false;
+
+        const uint32_t *offsets = &index_.offsets[0];
+        size_t i = index_pos_;
+        while(i < index_.count && (base + offsets[i]) < p) {
+            i++;
+        }
+
+        CsvCell *cell = &row_.cells[0];
+        const char *cell_start = p;
+        row_.count = 0;
+
+        for(; i < index_.count; i++) {
+            const char *q = base + offsets[i];
+            if(projection_end_) {
+                // Past the last projected column, only a newline matters.
+                if(row_.count < projection_end_) {
+                    if(projection_[row_.count]) {
+                        set_cell(&row_.cells[row_.count], cell_start, q);
+                    }
+                    ++row_.count;
+                }
+            } else {
+                if(row_.count == row_.cells.size()) {
+                    _resize();
+                    cell = &row_.cells[row_.count];
+                }
+
+                set_cell(cell++, cell_start, q);
+                ++row_.count;
+            }
+            if(*q == delimiter_) {
+                cell_start = q + 1;
+            } else {
+                index_pos_ = i + 1;
+                p_ = q + 1;
+                return kCsmTryParseOkay;
+            }
+        }
+
+        if(index_endp < endp_) {
+            // The record spans the end of the index, but more input is
+            // available. Reindex from the start of the record, doubling the
+            // window if the record already began at the start of the index.
+            if(p == base) {
+                index_window_ *= 2;
+            } else {
+                index_window_ = StructuralIndex::kBlockSize;
+            }
+            build_index(p);
+            goto check_index;
+        }
+
+        return kCsmTryParseUnderrun;
+    }
+
+    void
+    build_index(const char *p)
+    {
+        index_.build(p, std::min(index_window_, (size_t) (endp_ - p)));
+        index_pos_ = 0;
+    }
+
+    /**
+     * Discard block classifications cached by the spanners, and the
+     * structural index, since the buffer they describe may have changed.
+     */
+    void
+    invalidate()
+    {
+        fallback_spanners_.reset();
+#ifdef CSM_X86
+        sse42_spanners_.reset();
+        avx2_spanners_.reset();
+        avx512_spanners_.reset();
+#endif
+        index_.clear();
+    }
+
+    bool
+    fill()
+    {
+        invalidate();
+        return stream_.fill();
+    }
+
+    public:
+
+    /**
+     * Extract CsvCell pointers to fields with a particular value. Used as a
+     * convenience for parsing the header row into a list of desired columns.
+     * Throws csvmonkey::Error if a desired column is not found in the row.
+     *
+     * @example
+     *      CsvCell *resource_id;
+     *      CsvCell *item_description;
+     *
+     *      if(! reader.read_row()) {
+     *          throw Error("cannot parse header row");
+     *      }
+     *
+     *      reader.extract_fields({
+     *          {"ResourceId", &resource_id},
+     *          {"ItemDescription", &item_description},
+     *      });
+     */
+    void
+    extract_fields(const std::vector<FieldPair> &pairs)
+    {
+        for(const auto &pair : pairs) {
+            if(! row_.by_value(pair.name, *pair.cell)) {
+                std::string e("Could not find required header: ");
+                e.append(pair.name);
+                throw Error("extract_fields", e);
+            }
+        }
+    }
+
+    void
+    _resize()
+    {
+        auto &cells = row_.cells;
+        auto size = cells.size() * 2;
+        if(! size) {
+            size = 32;
+        }
+
+        cells.resize(size);
+        // For as_str()
+        for(size_t i = 0; i < size; i++) {
+            CsvCell &cell = cells[i];
+            cell.quotechar = quotechar_;
+            cell.escapechar = escapechar_;
+        }
+    }
+
+    bool
+    read_row()
+    {
+        const char *p;
+        CSM_DEBUG("")
+
+        do {
+            p = stream_.buf();
+            p_ = p;
+            endp_ = p + stream_.size();
+            switch(two_stage_ ? try_parse_indexed() : (this->*try_parse_)()) {
+                case kCsmTryParseOkay:
+                    stream_.consume(p_ - p);
+                    return true;
+                case kCsmTryParseOverflow:
+                    _resize();
+                    return read_row();
+                case kCsmTryParseUnderrun:
+                    ;
+            }
+            CSM_DEBUG("attempting fill!")
+        } while(fill());
+
+        if(row_.count && yield_incomplete_row_) {
+            CSM_DEBUG("stream fill failed, but partial row exists")
+            stream_.consume(endp_ - p);
+            return true;
+        }
+
+        CSM_DEBUG("stream fill failed")
+        return false;
+    }
+
+    /**
+     * Enable or disable two-stage parsing. When enabled, rows are produced by
+     * slicing a StructuralIndex built for up to StructuralIndex::kBlockSize
+     * bytes of input at a time, rather than by try_parse(). Since the index
+     * is derived from quote parity, quotes may only appear around entire
+     * fields. Throws csvmonkey::Error if an escape character is configured.
+     */
+    void
+    set_two_stage(bool enable)
+    {
+        if(enable && escapechar_) {
+            throw Error("set_two_stage", "escape characters are unsupported");
+        }
+        two_stage_ = enable;
+        index_.clear();
+    }
+
+    /**
+     * Return the kernel in use.
+     */
+    CsmKernel
+    kernel() const
+    {
+        return kernel_;
+    }
+
+    /**
+     * Select the kernel used for parsing. By default the best kernel
+     * supported by the running CPU is chosen at construction, or the kernel
+     * named by the CSVMONKEY_KERNEL environment variable. Throws
+     * csvmonkey::Error if the running CPU does not support `kernel`.
+     */
+    void
+    set_kernel(CsmKernel kernel)
+    {
+        index_.set_kernel(kernel);
+        kernel_ = index_.kernel();
+        if(projection_end_) {
+            select_try_parse<true>();
+        } else {
+            select_try_parse<false>();
+        }
+        invalidate();
+    }
+
+    /**
+     * Parse only the zero-based column indices listed in `columns`. Cells for
+     * other columns are not written, and must not be accessed. Parsing of
+     * each record stops following the largest listed column, after which the
+     * remainder of the record is skipped, so row().count never exceeds one
+     * more than the largest listed column. Shorter records are parsed as
+     * usual. An empty list restores parsing of every column.
+     *
+     * Unless an escape character is configured, the remainder of a record is
+     * skipped using quote parity, so there quotes may only appear around
+     * entire fields, as with set_two_stage().
+     *
+     * If a listed column lies beyond the cells allocated so far, row().cells
+     * is grown, invalidating pointers previously obtained from it. Columns
+     * located by extract_fields() are always within the allocation, so its
+     * pointers remain valid.
+     *
+     * @example
+     *      reader.extract_fields({
+     *          {"ResourceId", &resource_id},
+     *          {"ItemDescription", &item_description},
+     *      });
+     *      reader.set_columns({
+     *          (size_t) (resource_id - &reader.row().cells[0]),
+     *          (size_t) (item_description - &reader.row().cells[0]),
+     *      });
+     */
+    void
+    set_columns(const std::vector<size_t> &columns)
+    {
+        projection_.clear();
+        projection_end_ = 0;
+        for(size_t column : columns) {
+            if(column >= projection_.size()) {
+                projection_.resize(column + 1);
+            }
+            projection_[column] = 1;
+        }
+
+        projection_end_ = projection_.size();
+        while(row_.cells.size() < projection_end_) {
+            _resize();
+        }
+        set_kernel(kernel_);
+    }
+
+    /**
+     * Discard state cached about the stream's buffer. Must be called if the
+     * stream is repositioned by anything other than read_row().
+     */
+    void
+    reset()
+    {
+        invalidate();
+    }
+
+    /**
+     * Reposition the stream so the next call to read_row() returns record
+     * `n`, counting from zero, using an index built for the stream. Return
+     * false if the input has fewer records. Only available when reading a
+     * MappedFileCursor.
+     */
+    bool
+    seek_record(size_t n, const RowOffsetIndex &index)
+    {
+        uint64_t offset;
+        if(! index.record_offset(stream_, n, offset)) {
+            return false;
+        }
+        stream_.seek(offset);
+        reset();
+        return true;
+    }
+
+    CsvCursor &
+    row()
+    {
+        return row_;
+    }
+
+    CsvReader(StreamCursorType &stream,
+            char delimiter=',',
+            char quotechar='"',
+            char escapechar=0,
+            bool yield_incomplete_row=false)
+        : endp_(stream.buf() + stream.size())
+        , p_(stream.buf())
+        , delimiter_(delimiter)
+        , quotechar_(quotechar)
+        , escapechar_(escapechar)
+        , yield_incomplete_row_(yield_incomplete_row)
+        , stream_(stream)
+        , fallback_spanners_(delimiter, quotechar, escapechar)
+#ifdef CSM_X86
+        , sse42_spanners_(delimiter, quotechar, escapechar)
+        , avx2_spanners_(delimiter, quotechar, escapechar)
+        , avx512_spanners_(delimiter, quotechar, escapechar)
+#endif
+        , row_()
+        , projection_()
+        , projection_end_(0)
+        , skip_cell_()
+        , two_stage_(false)
+        , index_(delimiter, quotechar)
+        , index_pos_(0)
+        , index_window_(StructuralIndex::kBlockSize)
+    {
+        set_kernel(kCsmKernelAuto);
+        _resize();
+    }
+};
+
+
+/**
+ * Summary of one column within a block of records, used to decide whether a
+ * block may contain values matching a predicate without parsing it. Empty
+ * cells, and cells missing from short records, are counted as nulls.
+ */
+struct ColumnBlockStats
+{
+    /// Strings longer than this are not used as range bounds.
+    static const size_t kMaxStringBytes = 64;
+    /// HyperLogLog registers; 64 gives roughly 13% standard error.
+    static const size_t kSketchRegisters = 64;
+
+    uint64_t nulls;
+    uint64_t values;
+    /// True if every non-null value parsed as a finite number.
+    bool numeric;
+    double min;
+    double max;
+    /// True if min_str and max_str bound every non-null value.
+    bool string_range;
+    std::string min_str;
+    std::string max_str;
+    uint8_t sketch[kSketchRegisters];
+
+    ColumnBlockStats()
+        : nulls(0)
+        , values(0)
+        , numeric(true)
+        , min(0)
+        , max(0)
+        , string_range(true)
+        , min_str()
+        , max_str()
+    {
+        ::memset(sketch, 0, sizeof sketch);
+    }
+
+    void
+    add(const char *p, size_t size)
+    {
+        if(! size) {
+            nulls++;
+            return;
+        }
+
+        if(numeric) {
+            // NaN would make every range comparison false.
+            const char *end;
+            double d = parse_double(p, p + size, &end);
+            if(end != (p + size) || ! std::isfinite(d)) {
+                numeric = false;
+            } else if(! values) {
+                min = max = d;
+            } else {
+                min = std::min(min, d);
+                max = std::max(max, d);
+            }
+        }
+
+        if(size > kMaxStringBytes) {
+            string_range = false;
+        } else if(string_range) {
+            if((! values) || min_str.compare(0, std::string::npos, p, size) > 0) {
+                min_str.assign(p, size);
+            }
+            if((! values) || max_str.compare(0, std::string::npos, p, size) < 0) {
+                max_str.assign(p, size);
+            }
+        }
+
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for(size_t i = 0; i < size; i++) {
+            h = (h ^ (uint8_t) p[i]) * 0x100000001b3ULL;
+        }
+        // Finalize, since FNV-1a's high bits are poorly mixed.
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        uint64_t rest = (h << 6) | (1 << 5);
+        uint8_t rank = (uint8_t) (__builtin_clzll(rest) + 1);
+        uint8_t &reg = sketch[h >> 58];
+        reg = std::max(reg, rank);
+        values++;
+    }
+
+    /**
+     * Return the estimated number of distinct non-null values.
+     */
+    double
+    distinct() const
+    {
+        double m = kSketchRegisters;
+        double sum = 0;
+        size_t zeros = 0;
+        for(uint8_t reg : sketch) {
+            sum += 1.0 / (double) (1ULL << reg);
+            zeros += !reg;
+        }
+
+        double estimate = (0.709 * m * m) / sum;
+        if(estimate <= (2.5 * m) && zeros) {
+            estimate = m * std::log(m / zeros);
+        }
+        return std::min(estimate, (double) values);
+    }
+
+    /**
+     * Return false if no cell in the block can equal `s`.
+     */
+    bool
+    may_equal(const std::string &s) const
+    {
+        if(s.empty()) {
+            return nulls > 0;
+        }
+        if(! values) {
+            return false;
+        }
+        return (! string_range) || (s >= min_str && s <= max_str);
+    }
+
+    /**
+     * Return false if no cell in the block can be a number in [lo, hi].
+     */
+    bool
+    may_overlap(double lo, double hi) const
+    {
+        if(! values) {
+            return false;
+        }
+        return (! numeric) || (max >= lo && min <= hi);
+    }
+};
+
+
+/**
+ * Per-block column statistics for a MappedFileCursor, allowing a filtered
+ * scan to skip blocks that cannot match, in the style of a zone map. The
+ * input is divided into blocks of a fixed number of records, and a
+ * ColumnBlockStats is kept for every column of every block. Statistics may
+ * be saved to a sidecar file, validated as with RowOffsetIndex.
+ *
+ * @example
+ *      for(size_t i = 0; i < stats.blocks(); i++) {
+ *          if(stats.column(i, kRecordType).may_equal("LineItem")) {
+ *              stream.seek(stats.block_offset(i));
+ *              reader.reset();
+ *              for(size_t j = 0; j < stats.block_rows(i); j++) {
+ *                  reader.read_row();
+ *                  ...
+ *              }
+ *          }
+ *      }
+ */
+class ColumnStatsIndex
+{
+    static const uint64_t kVersion = 1;
+
+    struct Block
+    {
+        uint64_t offset;
+        uint64_t rows;
+        std::vector<ColumnBlockStats> columns;
+    };
+
+    char delimiter_;
+    char quotechar_;
+    uint64_t file_size_;
+    int64_t mtime_ns_;
+    uint64_t hash_;
+    std::vector<Block> blocks_;
+
+    template<class T>
+    static void
+    put(std::ostream &out, const T &value)
+    {
+        out.write((const char *) &value, sizeof value);
+    }
+
+    template<class T>
+    static void
+    get(std::istream &in, T &value)
+    {
+        in.read((char *) &value, sizeof value);
+    }
+
+    static void
+    get_bool(std::istream &in, bool &value)
+    {
+        uint8_t byte = 0;
+        get(in, byte);
+        if(byte > 1) {
+            in.setstate(std::ios::failbit);
+        }
+        value = byte;
+    }
+
+    /// Bytes left in `in`, or 0 once it has failed.
+    static uint64_t
+    remaining(std::istream &in, uint64_t size)
+    {
+        std::streamoff pos = in ? (std::streamoff) in.tellg() : -1;
+        return (pos < 0 || (uint64_t) pos > size) ? 0 : size - pos;
+    }
+
+    static void
+    put_str(std::ostream &out, const std::string &s)
+    {
+        put(out, (uint64_t) s.size());
+        out.write(s.data(), s.size());
+    }
+
+    static void
+    get_str(std::istream &in, std::string &s)
+    {
+        uint64_t size = 0;
+        get(in, size);
+        if(size > ColumnBlockStats::kMaxStringBytes) {
+            in.setstate(std::ios::failbit);
+            return;
+        }
+        s.resize(size);
+        in.read(&s[0], size);
+    }
+
+    public:
+    static const size_t kDefaultBlockRows = 65536;
+
+    ColumnStatsIndex(char delimiter=',', char quotechar='"')
+        : delimiter_(delimiter)
+        , quotechar_(quotechar)
+        , file_size_(0)
+        , mtime_ns_(0)
+        , hash_(0)
+        , blocks_()
+    {
+    }
+
+    /**
+     * Return the sidecar path conventionally used for `path`.
+     */
+    static std::string
+    sidecar_path(const std::string &path)
+    {
+        return path + ".csmstats";
+    }
+
+    /**
+     * Collect statistics for the records remaining in `stream`, without
+     * consuming them, in blocks of `block_rows` records. A header row should
+     * first be consumed by the caller.
+     */
+    void
+    build(MappedFileCursor &stream, size_t block_rows=kDefaultBlockRows)
+    {
+        block_rows = std::max((size_t) 1, block_rows);
+        const char *startp = stream.startp();
+        BufferCursor cursor(stream.buf(), startp + stream.file_size());
+        CsvReader<BufferCursor> reader(cursor, delimiter_, quotechar_);
+        CsvCursor &row = reader.row();
+
+        blocks_.clear();
+        for(;;) {
+            uint64_t offset = cursor.buf() - startp;
+            if(! reader.read_row()) {
+                break;
+            }
+
+            if(blocks_.empty() || blocks_.back().rows == block_rows) {
+                blocks_.push_back(Block {offset, 0, {}});
+            }
+
+            Block &block = blocks_.back();
+            if(block.columns.size() < row.count) {
+                ColumnBlockStats missing;
+                missing.nulls = block.rows;
+                block.columns.resize(row.count, missing);
+            }
+            for(size_t i = 0; i < row.count; i++) {
+                CsvCell &cell = row.cells[i];
+                if(cell.escaped) {
+                    std::string s = cell.as_str();
+                    block.columns[i].add(s.c_str(), s.size());
+                } else {
+                    block.columns[i].add(cell.ptr, cell.size);
+                }
+            }
+            for(size_t i = row.count; i < block.columns.size(); i++) {
+                block.columns[i].nulls++;
+            }
+            block.rows++;
+        }
+
+        // Give every block the same columns, the extra ones entirely null.
+        size_t ncolumns = 0;
+        for(Block &block : blocks_) {
+            ncolumns = std::max(ncolumns, block.columns.size());
+        }
+        for(Block &block : blocks_) {
+            ColumnBlockStats missing;
+            missing.nulls = block.rows;
+            block.columns.resize(ncolumns, missing);
+        }
+
+        file_size_ = stream.file_size();
+        mtime_ns_ = stream.mtime_ns();
+        hash_ = fingerprint(stream);
+    }
+
+    /**
+     * Write statistics to `path`. Throws csvmonkey::Error on failure.
+     */
+    void
+    save(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write("CSMSTAT", sizeof "CSMSTAT");
+        put(out, (uint64_t) kVersion);
+        put(out, file_size_);
+        put(out, mtime_ns_);
+        put(out, hash_);
+        put(out, delimiter_);
+        put(out, quotechar_);
+        put(out, (uint64_t) blocks_.size());
+        for(const Block &block : blocks_) {
+            put(out, block.offset);
+            put(out, block.rows);
+            put(out, (uint64_t) block.columns.size());
+            for(const ColumnBlockStats &column : block.columns) {
+                put(out, column.nulls);
+                put(out, column.values);
+                put(out, (uint8_t) column.numeric);
+                put(out, column.min);
+                put(out, column.max);
+                put(out, (uint8_t) column.string_range);
+                put_str(out, column.min_str);
+                put_str(out, column.max_str);
+                out.write((const char *) column.sketch, sizeof column.sketch);
+            }
+        }
+
+        out.close();
+        if(! out) {
+            throw Error(path.c_str(), "could not write statistics");
+        }
+    }
+
+    /**
+     * Load statistics for `stream` from `path`. Return false if `path` does
+     * not exist, or describes a different version of the input or different
+     * parsing options. Throws csvmonkey::Error if `path` is not a valid
+     * statistics file.
+     */
+    bool
+    load(const std::string &path, MappedFileCursor &stream)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if(! in) {
+            return false;
+        }
+        uint64_t size = in.tellg();
+        in.seekg(0);
+
+        char magic[sizeof "CSMSTAT"];
+        uint64_t version = 0;
+        in.read(magic, sizeof magic);
+        get(in, version);
+        if((! in) || ::memcmp(magic, "CSMSTAT", sizeof magic) ||
+                version != kVersion) {
+            throw Error(path.c_str(), "not a csvmonkey statistics file");
+        }
+
+        uint64_t file_size = 0;
+        int64_t mtime_ns = 0;
+        uint64_t hash = 0;
+        char delimiter = 0;
+        char quotechar = 0;
+        get(in, file_size);
+        get(in, mtime_ns);
+        get(in, hash);
+        get(in, delimiter);
+        get(in, quotechar);
+        if(file_size != stream.file_size() ||
+                mtime_ns != stream.mtime_ns() ||
+                delimiter != delimiter_ ||
+                quotechar != quotechar_ ||
+                hash != fingerprint(stream)) {
+            return false;
+        }
+
+        // Smallest encodings of a block and of a column, used to reject
+        // counts the file is too short to hold before looping over them.
+        const uint64_t kBlockBytes = 3 * sizeof(uint64_t);
+        const uint64_t kColumnBytes = 6 * sizeof(uint64_t) + 2 +
+            ColumnBlockStats::kSketchRegisters;
+
+        uint64_t nblocks = 0;
+        get(in, nblocks);
+        if(nblocks > remaining(in, size) / kBlockBytes) {
+            in.setstate(std::ios::failbit);
+        }
+        std::vector<Block> blocks;
+        for(uint64_t i = 0; in && i < nblocks; i++) {
+            Block block;
+            uint64_t ncolumns = 0;
+            get(in, block.offset);
+            get(in, block.rows);
+            get(in, ncolumns);
+            if(ncolumns > remaining(in, size) / kColumnBytes) {
+                in.setstate(std::ios::failbit);
+            }
+            for(uint64_t j = 0; in && j < ncolumns; j++) {
+                ColumnBlockStats column;
+                get(in, column.nulls);
+                get(in, column.values);
+                get_bool(in, column.numeric);
+                get(in, column.min);
+                get(in, column.max);
+                get_bool(in, column.string_range);
+                get_str(in, column.min_str);
+                get_str(in, column.max_str);
+                in.read((char *) column.sketch, sizeof column.sketch);
+                block.columns.push_back(column);
+            }
+            blocks.push_back(std::move(block));
+        }
+
+        if(! in) {
+            throw Error(path.c_str(), "truncated statistics file");
+        }
+
+        file_size_ = file_size;
+        mtime_ns_ = mtime_ns;
+        hash_ = hash;
+        blocks_.swap(blocks);
+        return true;
+    }
+
+    size_t
+    blocks() const
+    {
+        return blocks_.size();
+    }
+
+    /**
+     * Return the offset from the start of the input of block `i`'s first
+     * record.
+     */
+    uint64_t
+    block_offset(size_t i) const
+    {
+        return blocks_[i].offset;
+    }
+
+    size_t
+    block_rows(size_t i) const
+    {
+        return blocks_[i].rows;
+    }
+
+    /**
+     * Return the number of columns in the widest record.
+     */
+    size_t
+    columns() const
+    {
+        return blocks_.empty() ? 0 : blocks_[0].columns.size();
+    }
+
+    /**
+     * Return statistics for `column`, which must be less than columns(),
+     * within block `i`.
+     */
+    const ColumnBlockStats &
+    column(size_t i, size_t column) const
+    {
+        return blocks_[i].columns[column];
+    }
+};
+
+/**
+ * A single row within a CsvRowBatch.
+ */
+struct CsvRow
+{
+    CsvCell *cells;
+    size_t count;
+};
+
+
+/**
+ * Rows parsed from one chunk of input by ParallelCsvReader. Cells of every
+ * row are stored contiguously, with ends[N] recording the index one past the
+ * final cell of row N. Cells point into the input mapping, so remain valid
+ * for as long as the MappedFileCursor does.
+ */
+class CsvRowBatch
+{
+    public:
+    /// Chunk number, batches are numbered in input order starting from 0.
+    size_t seq;
+    std::vector<CsvCell> cells;
+    std::vector<size_t> ends;
+
+    CsvRowBatch()
+        : seq(0)
+        , cells()
+        , ends()
+    {
+    }
+
+    void
+    clear()
+    {
+        cells.clear();
+        ends.clear();
+    }
+
+    size_t
+    rows() const
+    {
+        return ends.size();
+    }
+
+    CsvRow
+    row(size_t i)
+    {
+        size_t start = i ? ends[i - 1] : 0;
+        return CsvRow {cells.data() + start, ends[i] - start};
+    }
+};
+
+
+/**
+ * Contiguous range of rows within a CsvRowBatch, as passed to
+ * ParallelCsvReader::for_each_batch() callbacks.
+ */
+class CsvRowSpan
+{
+    CsvRowBatch *batch_;
+    size_t begin_;
+    size_t end_;
+
+    public:
+    CsvRowSpan(CsvRowBatch *batch, size_t begin, size_t end)
+        : batch_(batch)
+        , begin_(begin)
+        , end_(end)
+    {
+    }
+
+    /// Sequence number of the batch the span was taken from.
+    size_t
+    seq() const
+    {
+        return batch_->seq;
+    }
+
+    /// Index of the span's first row within its batch.
+    size_t
+    offset() const
+    {
+        return begin_;
+    }
+
+    size_t
+    rows() const
+    {
+        return end_ - begin_;
+    }
+
+    CsvRow
+    row(size_t i)
+    {
+        return batch_->row(begin_ + i);
+    }
+};
+
+
+/**
+ * Fixed set of threads running tasks from per-thread deques. Each thread
+ * takes the newest task from its own deque, and when that is empty, steals
+ * the oldest task from another thread's deque, so a few expensive tasks do
+ * not leave the remaining threads idle. Only the deques' own locks are taken
+ * to dispatch tasks; the pool-wide locks serve just to sleep and wake.
+ */
+class WorkStealingPool
+{
+    public:
+    typedef std::function<void()> Task;
+
+    private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    /// Tasks sitting in a deque, updated under the deque's lock.
+    std::atomic<size_t> queued_;
+    /// Tasks submitted but not yet finished.
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> next_queue_;
+
+    /// Guards stop_ while idle threads sleep on idle_cond_.
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cond_;
+    std::atomic<size_t> sleeping_;
+    bool stop_;
+
+    /// Guards error_ while wait() sleeps on done_cond_.
+    std::mutex done_mutex_;
+    std::condition_variable done_cond_;
+    std::atomic<size_t> waiters_;
+    std::exception_ptr error_;
+
+    bool
+    pop(size_t self, Task &task)
+    {
+        for(size_t i = 0; i < queues_.size(); i++) {
+            Queue &queue = *queues_[(self + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(queue.tasks.size()) {
+                if(i) {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                } else {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+                queued_--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void
+    finish(std::exception_ptr error)
+    {
+        if(error) {
+            std::lock_guard<std::mutex> lock(done_mutex_);
+            if(! error_) {
+                error_ = error;
+            }
+        }
+        pending_--;
+        // Pairs with wait() counting itself before testing pending_.
+        if(error || waiters_) {
+            std::lock_guard<std::mutex> lock(done_mutex_);
+            done_cond_.notify_all();
+        }
+    }
+
+    void
+    run(size_t self)
+    {
+        for(;;) {
+            Task task;
+            if(! pop(self, task)) {
+                std::unique_lock<std::mutex> lock(idle_mutex_);
+                // Pairs with submit() counting the task before testing
+                // sleeping_, so a task is either seen here or wakes us.
+                sleeping_++;
+                idle_cond_.wait(lock, [&] { return stop_ || queued_; });
+                sleeping_--;
+                if(stop_) {
+                    return;
+                }
+                // A task queued after pop() passed its deque, or another
+                // thread took it first; either way pop() again.
+                continue;
+            }
+
+            std::exception_ptr error;
+            try {
+                task();
+            } catch(...) {
+                error = std::current_exception();
+            }
+            finish(error);
+        }
+    }
+
+    public:
+    WorkStealingPool(size_t threads)
+        : queues_()
+        , threads_()
+        , queued_(0)
+        , pending_(0)
+        , next_queue_(0)
+        , sleeping_(0)
+        , stop_(false)
+        , waiters_(0)
+    {
+        threads = std::max((size_t) 1, threads);
+        for(size_t i = 0; i < threads; i++) {
+            queues_.emplace_back(new Queue);
+        }
+        for(size_t i = 0; i < threads; i++) {
+            threads_.emplace_back(&WorkStealingPool::run, this, i);
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            stop_ = true;
+        }
+        idle_cond_.notify_all();
+        for(auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    /**
+     * Queue `task`, distributing tasks among the threads' deques in turn.
+     */
+    void
+    submit(Task task)
+    {
+        pending_++;
+        Queue &queue = *queues_[next_queue_++ % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+            queued_++;
+        }
+        if(sleeping_) {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            idle_cond_.notify_one();
+        }
+    }
+
+    /**
+     * Wait until fewer than `limit` submitted tasks remain unfinished, then
+     * rethrow the first exception raised by any task.
+     */
+    void
+    wait(size_t limit=1)
+    {
+        std::unique_lock<std::mutex> lock(done_mutex_);
+        waiters_++;
+        done_cond_.wait(lock, [&] { return error_ || pending_ < limit; });
+        waiters_--;
+        if(error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+};
+
+
+/**
+ * Return the last occurrence of `c` among the `n` bytes at `p`, or NULL.
+ * Uses memrchr() where glibc provides it.
+ */
+inline const char *
+find_last(const char *p, char c, size_t n)
+{
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    return (const char *) memrchr(p, c, n);
+#else
+    for(const char *q = p + n; q > p;) {
+        if(*--q == c) {
+            return q;
+        }
+    }
+    return NULL;
+#endif
+}
+
+
+/**
+ * Find record boundaries at arbitrary offsets within a buffer, without
+ * parsing everything preceding them. Used to split input for parallel
+ * parsing.
+ *
+ * Whether an offset falls inside a quoted field is speculated by scanning
+ * backwards over a window of preceding bytes for a quote whose neighbours
+ * identify it as opening or closing a field, e.g. `,"a` or `a",`, then
+ * applying the parity of quotes between it and the offset. If the window
+ * holds no such quote, its start is assumed to fall outside quotes, which is
+ * exact when the window reaches the start of the buffer.
+ *
+ * The guess may be wrong, for example when a quoted field is longer than the
+ * window, so callers must confirm the boundary by parsing up to it.
+ */
+class RecordSpeculator
+{
+    const char *startp_;
+    const char *endp_;
+    char delimiter_;
+    char quotechar_;
+    size_t window_;
+
+    bool
+    structural(char c) const
+    {
+        return c == delimiter_ || c == '\r' || c == '\n';
+    }
+
+    public:
+    static const size_t kDefaultWindow = 64 << 10;
+
+    RecordSpeculator(const char *startp, const char *endp,
+                     char delimiter=',', char quotechar='"',
+                     size_t window=kDefaultWindow)
+        : startp_(startp)
+        , endp_(endp)
+        , delimiter_(delimiter)
+        , quotechar_(quotechar)
+        , window_(window)
+    {
+    }
+
+    /**
+     * Guess whether `p` falls inside a quoted field.
+     */
+    bool
+    quoted_at(const char *p) const
+    {
+        const char *windowp = ((size_t) (p - startp_) > window_)
+            ? (p - window_)
+            : startp_;
+
+        size_t quotes = 0;
+        const char *q = p;
+        while((q = find_last(windowp, quotechar_, q - windowp))) {
+            char prev = (q > startp_) ? q[-1] : '\n';
+            char next = ((q + 1) < endp_) ? q[1] : '\n';
+            if(structural(prev) && !(structural(next) || next == quotechar_)) {
+                return !(quotes & 1);
+            }
+            if(structural(next) && !(structural(prev) || prev == quotechar_)) {
+                return quotes & 1;
+            }
+            quotes++;
+        }
+        return quotes & 1;
+    }
+
+    /**
+     * Return the byte following the first newline at or after `p` that
+     * appears outside quotes, given whether `p` is inside quotes, or the end
+     * of the buffer if none exists.
+     */
+    const char *
+    next_record(const char *p, bool quoted) const
+    {
+        for(; p < endp_; p++) {
+            if(*p == quotechar_) {
+                quoted = !quoted;
+            } else if((! quoted) && (*p == '\n' || *p == '\r')) {
+                return p + 1;
+            }
+        }
+        return endp_;
+    }
+
+    const char *
+    speculate(const char *p) const
+    {
+        if(p == startp_ || p >= endp_) {
+            return std::min(p, endp_);
+        }
+        return next_record(p, quoted_at(p));
+    }
+};
+
+
+/**
+ * Parse a MappedFileCursor using multiple threads. The mapping is split into
+ * fixed size chunks, each chunk is moved forward to the following record
+ * boundary, and chunks are parsed concurrently into CsvRowBatches.
+ *
+ * By default chunk boundaries are found using RecordSpeculator. Since a
+ * chunk ends where the next chunk's boundary was placed, the boundary is
+ * confirmed once the preceding chunk parses up to it without leaving an
+ * incomplete row. Otherwise the speculation was wrong, and the affected
+ * chunk is parsed again from the start of the incomplete row on the thread
+ * calling read_batch(). Since confirmation happens in order, batches are
+ * always returned in order.
+ *
+ * Alternatively set_speculative(false) counts quote characters in every
+ * chunk in parallel before parsing begins, so whether each chunk begins
+ * inside a quoted field is known exactly from the parity of quotes preceding
+ * it. This costs an extra pass over the input, but allows batches to be
+ * returned out of order.
+ *
+ * As with two-stage parsing, quotes may only appear around entire fields,
+ * and escape characters are not supported.
+ *
+ * @example
+ *      MappedFileCursor stream;
+ *      stream.open(path);
+ *      ParallelCsvReader reader(stream);
+ *      CsvRowBatch batch;
+ *
+ *      while(reader.read_batch(batch)) {
+ *          for(size_t i = 0; i < batch.rows(); i++) {
+ *              CsvRow row = batch.row(i);
+ *              ...
+ *          }
+ *      }
+ */
+class ParallelCsvReader
+{
+    public:
+    static const size_t kDefaultChunkSize = 1 << 20;
+    static const size_t kDefaultBatchSize = 1024;
+
+    private:
+    typedef std::unique_ptr<CsvRowBatch> BatchPtr;
+
+    /**
+     * CsvReader over one chunk at a time, reused for successive chunks.
+     */
+    class ChunkParser
+    {
+        const char *input_endp_;
+        BufferCursor cursor_;
+        CsvReader<BufferCursor> reader_;
+        BufferCursor final_cursor_;
+        CsvReader<BufferCursor> final_reader_;
+
+        public:
+        ChunkParser(const ParallelCsvReader &owner)
+            : input_endp_(owner.endp_)
+            , cursor_()
+            , reader_(cursor_, owner.delimiter_, owner.quotechar_)
+            , final_cursor_()
+            , final_reader_(final_cursor_, owner.delimiter_, owner.quotechar_,
+                            0, owner.yield_incomplete_row_)
+        {
+            reader_.set_kernel(owner.kernel_);
+            reader_.set_two_stage(owner.two_stage_);
+            final_reader_.set_kernel(owner.kernel_);
+            final_reader_.set_two_stage(owner.two_stage_);
+            reader_.set_columns(owner.columns_);
+            final_reader_.set_columns(owner.columns_);
+        }
+
+        /**
+         * Append rows from `p` until `endp` to `batch`, stopping early after
+         * the first row ending at or beyond `stop`. Return the start of the
+         * row following those parsed, which is the start of an incomplete
+         * row if one remains at `endp`. Only a range ending at the end of
+         * input may yield an incomplete row.
+         */
+        const char *
+        parse(const char *p, const char *endp, const char *stop,
+              CsvRowBatch &batch)
+        {
+            bool final = endp == input_endp_;
+            BufferCursor &cursor = final ? final_cursor_ : cursor_;
+            CsvReader<BufferCursor> &reader = final ? final_reader_ : reader_;
+
+            cursor.reset(p, endp);
+            reader.reset();
+            while(reader.read_row()) {
+                CsvCursor &row = reader.row();
+                batch.cells.insert(batch.cells.end(),
+                                   row.cells.begin(),
+                                   row.cells.begin() + row.count);
+                batch.ends.push_back(batch.cells.size());
+                if(cursor.buf() >= stop) {
+                    return cursor.buf();
+                }
+            }
+
+            if(cursor.size() && ! reader.in_newline_skip) {
+                return cursor.buf();
+            }
+            return endp;
+        }
+    };
+
+    /**
+     * A batch parsed by a worker, awaiting delivery. `next` is the start of
+     * the row following the batch, which is the start of the following
+     * chunk if its boundary was speculated correctly.
+     */
+    struct Chunk
+    {
+        BatchPtr batch;
+        const char *start;
+        const char *endp;
+        const char *next;
+    };
+
+    const char *startp_;
+    const char *endp_;
+    char delimiter_;
+    char quotechar_;
+    bool yield_incomplete_row_;
 
-    in_quoted_cell:
-        PREAMBLE()
-        rc = quoted_cell_spanner_(p);
-        rc2 = quoted_cell_spanner_(p+16);
-        if(rc != 16) {
-            p += rc + 1;
-            goto in_escape_or_end_of_quoted_cell;
+    size_t threads_;
+    size_t chunk_size_;
+    size_t batch_size_;
+    bool ordered_;
+    bool two_stage_;
+    bool speculative_;
+    size_t window_;
+    CsmKernel kernel_;
+    std::vector<size_t> columns_;
+
+    /// Quote parity preceding each chunk's nominal start, if not speculative.
+    std::vector<uint8_t> parity_;
+    size_t chunks_;
+    bool started_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::thread> workers_;
+    std::map<size_t, Chunk> ready_;
+    std::vector<BatchPtr> free_;
+    std::exception_ptr error_;
+    size_t next_chunk_;
+    size_t delivered_;
+    bool stop_;
+
+    /// Start of the row following the last batch returned.
+    const char *resume_;
+    size_t rescans_;
+    std::unique_ptr<ChunkParser> rescan_parser_;
+
+    const char *
+    nominal_start(size_t chunk) const
+    {
+        return startp_ + std::min(chunk * chunk_size_,
+                                  (size_t) (endp_ - startp_));
+    }
+
+    /**
+     * Return the record boundary at which `chunk` begins. Chunk 0 always
+     * starts at the beginning of input.
+     */
+    const char *
+    record_start(size_t chunk) const
+    {
+        const char *p = nominal_start(chunk);
+        RecordSpeculator speculator(startp_, endp_, delimiter_, quotechar_,
+                                    window_);
+        if(speculative_ || (! chunk) || p == endp_) {
+            return speculator.speculate(p);
         }
+        return speculator.next_record(p, parity_[chunk]);
+    }
+
+    void
+    count_parity()
+    {
+        std::vector<size_t> counts(chunks_);
+        std::vector<std::thread> threads;
+        size_t nthreads = std::min(threads_, chunks_);
 
-        switch(rc2) {
-            case 16:
-                p += 32;
-                goto in_quoted_cell;
-            default:
-                p += rc2 + 1 + 16;
-                goto in_escape_or_end_of_quoted_cell;
+        for(size_t t = 0; t < nthreads; t++) {
+            threads.emplace_back([&, t] {
+                StructuralIndex index(delimiter_, quotechar_, kernel_);
+                for(size_t i = t; i < chunks_; i += nthreads) {
+                    const char *p = nominal_start(i);
+                    counts[i] = index.count_quotes(p, nominal_start(i + 1) - p);
+                }
+            });
+        }
+        for(auto &thread : threads) {
+            thread.join();
         }
 
-    in_escape_or_end_of_quoted_cell:
-        PREAMBLE()
-        if(*p == delimiter_) {
-            cell->ptr = cell_start;
-            cell->size = p - cell_start - 1;
-            ++row_.count;
-            NEXT_CELL();
-            ++p;
-            goto cell_start;
-        } else if(*p == '\r' || *p == '\n') {
-            cell->ptr = cell_start;
-            cell->size = p - cell_start - 1;
-            ++row_.count;
-            p_ = p + 1;
-            return kCsmTryParseOkay;
-        } else {
-            cell->escaped = true;
-            ++p;
-            goto in_quoted_cell;
+        parity_.assign(chunks_, 0);
+        for(size_t i = 1; i < chunks_; i++) {
+            parity_[i] = parity_[i - 1] ^ (counts[i - 1] & 1);
         }
+    }
 
-    in_unquoted_cell:
-        CSM_DEBUG("\n\nin_unquoted_cell")
-        PREAMBLE()
-        rc = unquoted_cell_spanner_(p);
-        CSM_DEBUG("unquoted span: %d; p[3]=%d p[..17]='%.17s'", rc, p[3], p);
-        rc2 = unquoted_cell_spanner_(p+16);
-        if(rc != 16) {
-            p += rc;
-            goto in_escape_or_end_of_unquoted_cell;
+    void
+    worker()
+    {
+        ChunkParser parser(*this);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        for(;;) {
+            // Bound the number of batches buffered ahead of the consumer.
+            cond_.wait(lock, [&] {
+                return stop_ || next_chunk_ == chunks_ ||
+                       next_chunk_ < delivered_ + (2 * threads_);
+            });
+            if(stop_ || next_chunk_ == chunks_) {
+                return;
+            }
+
+            size_t chunk = next_chunk_++;
+            Chunk out{};
+            if(free_.size()) {
+                out.batch = std::move(free_.back());
+                free_.pop_back();
+            } else {
+                out.batch.reset(new CsvRowBatch);
+            }
+            lock.unlock();
+
+            std::exception_ptr error;
+            try {
+                out.batch->seq = chunk;
+                out.batch->clear();
+                // Speculated boundaries may be out of order, in which case
+                // the chunk is empty and its successor is rescanned.
+                out.start = record_start(chunk);
+                out.endp = std::max(out.start, record_start(chunk + 1));
+                out.next = parser.parse(out.start, out.endp, out.endp,
+                                        *out.batch);
+            } catch(...) {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            if(error && ! error_) {
+                error_ = error;
+            }
+            ready_[chunk] = std::move(out);
+            cond_.notify_all();
         }
+    }
 
-        switch(rc2) {
-        case 16:
-            p += 32;
-            goto in_unquoted_cell;
-        default:
-            p += rc2 + 16;
-            goto in_escape_or_end_of_unquoted_cell;
+    /**
+     * The preceding batch did not end where `chunk` begins, so its boundary
+     * was speculated incorrectly. Discard its rows and parse again from the
+     * end of the preceding batch, continuing past the end of the chunk if
+     * necessary to finish the row straddling it. Each byte is therefore
+     * parsed at most twice, even if a single row spans many chunks.
+     */
+    void
+    rescan(Chunk &chunk)
+    {
+        if(! rescan_parser_) {
+            rescan_parser_.reset(new ChunkParser(*this));
         }
 
-    in_escape_or_end_of_unquoted_cell:
-        PREAMBLE()
-        if(*p == delimiter_) {
-            cell->ptr = cell_start;
-            cell->size = p - cell_start;
-            ++row_.count;
-            CSM_DEBUG("in_escape_or_end_of_unquoted_cell(DELIMITER)")
-            CSM_DEBUG("p[..17] = '%.17s'", p)
-            CSM_DEBUG("done cell: '%.*s'", (int)cell->size, cell->ptr)
-            NEXT_CELL();
-            ++p;
-            goto cell_start;
-        } else if(*p == '\r' || *p == '\n') {
-            CSM_DEBUG("in_escape_or_end_of_unquoted_cell(NEWLINE)")
-            cell->ptr = cell_start;
-            cell->size = p - cell_start;
-            ++row_.count;
-            p_ = p + 1;
-            return kCsmTryParseOkay;
+        chunk.batch->clear();
+        if(resume_ < chunk.endp) {
+            chunk.next = rescan_parser_->parse(resume_, endp_, chunk.endp,
+                                               *chunk.batch);
         } else {
-            cell->escaped = true;
-            ++p;
-            goto in_unquoted_cell;
+            chunk.next = resume_;
         }
+        rescans_++;
+    }
 
-        CSM_DEBUG("error out");
-        return kCsmTryParseUnderrun;
+    void
+    start()
+    {
+        if(! threads_) {
+            threads_ = std::max(1u, std::thread::hardware_concurrency());
+        }
+        chunks_ = std::max((size_t) 1,
+            ((endp_ - startp_) + chunk_size_ - 1) / chunk_size_);
+        if(! speculative_) {
+            count_parity();
+        }
+
+        started_ = true;
+        for(size_t t = 0; t < std::min(threads_, chunks_); t++) {
+            workers_.emplace_back(&ParallelCsvReader::worker, this);
+        }
     }
 
-    #undef PREAMBLE
-    #undef NEXT_CELL
+    void
+    check_not_started()
+    {
+        if(started_) {
+            throw Error("ParallelCsvReader", "reader already started");
+        }
+    }
 
     public:
+    ParallelCsvReader(MappedFileCursor &stream,
+                      char delimiter=',',
+                      char quotechar='"',
+                      bool yield_incomplete_row=false)
+        : startp_(stream.buf())
+        , endp_(stream.buf() + stream.size())
+        , delimiter_(delimiter)
+        , quotechar_(quotechar)
+        , yield_incomplete_row_(yield_incomplete_row)
+        , threads_(0)
+        , chunk_size_(kDefaultChunkSize)
+        , batch_size_(kDefaultBatchSize)
+        , ordered_(true)
+        , two_stage_(false)
+        , speculative_(true)
+        , window_(RecordSpeculator::kDefaultWindow)
+        , kernel_(kCsmKernelAuto)
+        , columns_()
+        , parity_()
+        , chunks_(0)
+        , started_(false)
+        , next_chunk_(0)
+        , delivered_(0)
+        , stop_(false)
+        , resume_(stream.buf())
+        , rescans_(0)
+        , rescan_parser_()
+    {
+    }
+
+    ~ParallelCsvReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for(auto &worker : workers_) {
+            worker.join();
+        }
+    }
 
     /**
-     * Extract CsvCell pointers to fields with a particular value. Used as a
-     * convenience for parsing the header row into a list of desired columns.
-     * Throws csvmonkey::Error if a desired column is not found in the row.
-     *
-     * @example
-     *      CsvCell *resource_id;
-     *      CsvCell *item_description;
-     *
-     *      if(! reader.read_row()) {
-     *          throw Error("cannot parse header row");
-     *      }
-     *
-     *      reader.extract_fields({
-     *          {"ResourceId", &resource_id},
-     *          {"ItemDescription", &item_description},
-     *      });
+     * Set the number of parsing threads. The default of 0 uses one thread
+     * per CPU.
      */
     void
-    extract_fields(const std::vector<FieldPair> &pairs)
+    set_threads(size_t threads)
     {
-        for(const auto &pair : pairs) {
-            if(! row_.by_value(pair.name, *pair.cell)) {
-                std::string e("Could not find required header: ");
-                e.append(pair.name);
-                throw Error("extract_fields", e);
-            }
-        }
+        check_not_started();
+        threads_ = threads;
     }
 
+    /**
+     * Set the approximate number of input bytes parsed into each batch.
+     */
     void
-    _resize()
+    set_chunk_size(size_t chunk_size)
     {
-        auto &cells = row_.cells;
-        auto size = cells.size() * 2;
-        if(! size) {
-            size = 32;
-        }
+        check_not_started();
+        chunk_size_ = std::max((size_t) 1, chunk_size);
+    }
 
-        cells.resize(size);
-        // For as_str()
-        for(size_t i = 0; i < size; i++) {
-            CsvCell &cell = cells[i];
-            cell.quotechar = quotechar_;
-            cell.escapechar = escapechar_;
-        }
+    /**
+     * Set the maximum number of rows passed to each for_each_batch()
+     * callback.
+     */
+    void
+    set_batch_size(size_t batch_size)
+    {
+        check_not_started();
+        batch_size_ = std::max((size_t) 1, batch_size);
     }
 
-    bool
-    read_row()
+    /**
+     * If true (the default), batches are returned in input order. Otherwise
+     * they are returned as soon as they are parsed, and CsvRowBatch::seq may
+     * be used to restore order. Only effective when not speculative.
+     */
+    void
+    set_ordered(bool ordered)
     {
-        const char *p;
-        CSM_DEBUG("")
+        check_not_started();
+        ordered_ = ordered;
+    }
 
-        do {
-            p = stream_.buf();
-            p_ = p;
-            endp_ = p + stream_.size();
-            switch(try_parse()) {
-                case kCsmTryParseOkay:
-                    stream_.consume(p_ - p);
-                    return true;
-                case kCsmTryParseOverflow:
-                    _resize();
-                    return read_row();
-                case kCsmTryParseUnderrun:
-                    ;
-            }
-            CSM_DEBUG("attempting fill!")
-        } while(stream_.fill());
+    void
+    set_two_stage(bool two_stage)
+    {
+        check_not_started();
+        two_stage_ = two_stage;
+    }
 
-        if(row_.count && yield_incomplete_row_) {
-            CSM_DEBUG("stream fill failed, but partial row exists")
-            stream_.consume(endp_ - p);
-            return true;
+    /**
+     * If true (the default), speculate chunk boundaries, otherwise find them
+     * exactly with a quote counting pre-pass.
+     */
+    void
+    set_speculative(bool speculative)
+    {
+        check_not_started();
+        speculative_ = speculative;
+    }
+
+    /**
+     * Set the number of bytes preceding each chunk examined when speculating
+     * its boundary.
+     */
+    void
+    set_window(size_t window)
+    {
+        check_not_started();
+        window_ = window;
+    }
+
+    /**
+     * Select the kernel used by every thread. Throws csvmonkey::Error if the
+     * running CPU does not support it.
+     */
+    void
+    set_kernel(CsmKernel kernel)
+    {
+        check_not_started();
+        if(! kernel_supported(kernel)) {
+            throw Error("set_kernel", "kernel unsupported by this CPU");
         }
+        kernel_ = kernel;
+    }
 
-        CSM_DEBUG("stream fill failed")
-        return false;
+    /**
+     * Parse only the listed zero-based column indices, as with
+     * CsvReader::set_columns(). Rows within batches retain one cell per
+     * column up to the largest listed, and cells for other columns must not
+     * be accessed.
+     */
+    void
+    set_columns(const std::vector<size_t> &columns)
+    {
+        check_not_started();
+        columns_ = columns;
     }
 
-    CsvCursor &
-    row()
+    /**
+     * Return the number of chunks so far parsed twice due to an incorrect
+     * boundary speculation.
+     */
+    size_t
+    rescans() const
     {
-        return row_;
+        return rescans_;
     }
 
-    CsvReader(StreamCursorType &stream,
-            char delimiter=',',
-            char quotechar='"',
-            char escapechar=0,
-            bool yield_incomplete_row=false)
-        : endp_(stream.buf() + stream.size())
-        , p_(stream.buf())
-        , delimiter_(delimiter)
-        , quotechar_(quotechar)
-        , escapechar_(escapechar)
-        , yield_incomplete_row_(yield_incomplete_row)
-        , stream_(stream)
-        , quoted_cell_spanner_(quotechar, escapechar)
-        , unquoted_cell_spanner_(delimiter, '\r', '\n', escapechar)
+    /**
+     * Replace the contents of `batch` with the next batch of rows, starting
+     * worker threads on first call. Return false once every batch has been
+     * returned. Exceptions raised by workers are rethrown here.
+     */
+    bool
+    read_batch(CsvRowBatch &batch)
     {
-        _resize();
+        if(! started_) {
+            start();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(delivered_ == chunks_) {
+            return false;
+        }
+
+        bool ordered = ordered_ || speculative_;
+        cond_.wait(lock, [&] {
+            return error_ || (ready_.size() &&
+                ((! ordered) || ready_.begin()->first == delivered_));
+        });
+        if(error_) {
+            std::rethrow_exception(error_);
+        }
+
+        auto it = ready_.begin();
+        Chunk chunk = std::move(it->second);
+        ready_.erase(it);
+        if(speculative_) {
+            lock.unlock();
+            if(chunk.start != resume_) {
+                rescan(chunk);
+            }
+            resume_ = chunk.next;
+            lock.lock();
+        }
+
+        // Recycle the caller's previous batch, so its memory is reused
+        // rather than faulted in afresh for every chunk.
+        std::swap(batch, *chunk.batch);
+        free_.push_back(std::move(chunk.batch));
+        delivered_++;
+        cond_.notify_all();
+        return true;
+    }
+
+    /**
+     * Call `fn` with a CsvRowSpan for every set_batch_size() rows of input.
+     * Calls are made concurrently and in no particular order by a
+     * WorkStealingPool running alongside the parsing threads, with the same
+     * number of threads, so `fn` must be thread safe. The first exception
+     * raised by `fn` is rethrown once running calls complete.
+     *
+     * @example
+     *      std::atomic<size_t> rows(0);
+     *      reader.for_each_batch([&](CsvRowSpan &span) {
+     *          rows += span.rows();
+     *      });
+     */
+    template<class Fn>
+    void
+    for_each_batch(Fn fn)
+    {
+        if(! started_) {
+            start();
+        }
+
+        struct Slot
+        {
+            CsvRowBatch batch;
+            /// Tasks still reading `batch`.
+            std::atomic<size_t> users;
+            Slot() : batch(), users(0) {}
+        };
+
+        // Declared before the pool, so running tasks finish first.
+        std::vector<std::unique_ptr<Slot>> slots;
+        WorkStealingPool pool(threads_);
+        for(;;) {
+            // Reuse a batch once every task reading it has finished; the
+            // acquire pairs with the tasks' release.
+            Slot *slot = nullptr;
+            for(auto &candidate : slots) {
+                if(candidate->users.load(std::memory_order_acquire) == 0) {
+                    slot = candidate.get();
+                    break;
+                }
+            }
+            if(! slot) {
+                slots.emplace_back(new Slot);
+                slot = slots.back().get();
+            }
+
+            if(! read_batch(slot->batch)) {
+                break;
+            }
+
+            for(size_t i = 0; i < slot->batch.rows(); i += batch_size_) {
+                size_t end = std::min(i + batch_size_, slot->batch.rows());
+                // Bound the number of spans waiting for a thread.
+                pool.wait(4 * threads_);
+                slot->users.fetch_add(1, std::memory_order_relaxed);
+                pool.submit([slot, i, end, &fn] {
+                    try {
+                        CsvRowSpan span(&slot->batch, i, end);
+                        fn(span);
+                    } catch(...) {
+                        slot->users.fetch_sub(1, std::memory_order_release);
+                        throw;
+                    }
+                    slot->users.fetch_sub(1, std::memory_order_release);
+                });
+            }
+        }
+        pool.wait();
     }
 };
 
@@ -32,11 +32,10 @@ ig = operator.itemgetter(*slices)
 
 writer = csv.writer(sys.stdout, quoting=csv.QUOTE_ALL)
 
-readers = [
-    csvmonkey.from_path(path, header=not args.no_header, yields='tuple')
-    for path in args.paths
-]
-if not readers:
+readers = []
+if args.paths:
+    readers.append(csvmonkey.from_paths(args.paths, header=not args.no_header, yields='tuple'))
+else:
     it = iter(sys.stdin.readline, '')
     readers.append(csvmonkey.from_iter(it, header=not args.no_header, yields='tuple'))
 
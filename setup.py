@@ -1,27 +1,8 @@
 
-from __future__ import print_function
-import os
-import sys
 
 from setuptools import Extension
 from setuptools import setup
 
-sys.path.insert(0,
-    os.path.join(
-        os.path.dirname(__file__),
-        'third_party',
-    )
-)
-
-import cpuid
-
-
-def has_sse42():
-    cpu = cpuid.CPUID()
-    regs = cpu(1)
-    return bool((1 << 20) & regs[2])
-
-
 extra_compile_args = []
 extra_compile_args += ['-std=c++11']
 extra_compile_args += ['-Iinclude']
@@ -38,13 +19,6 @@ extra_compile_args += ['-Wno-strict-prototypes']
 #extra_compile_args += ['-DCSVMONKEY_DEBUG']
 
 
-if has_sse42():
-    extra_compile_args += ['-msse4.2']
-else:
-    print("Warning: CPU lacks SSE4.2, compiling with fallback",
-          file=sys.stderr)
-
-
 setup(
     name='csvmonkey',
     author='David Wilson',
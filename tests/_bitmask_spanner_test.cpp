@@ -0,0 +1,110 @@
+#include <string>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+
+
+using Spanner = csvmonkey::BitmaskSpanner<MATCHER>;
+
+
+#define SKIP_UNLESS_SUPPORTED() \
+    if(! csvmonkey::kernel_supported(KERNEL)) { \
+        WARN("kernel unsupported by this CPU"); \
+        return; \
+    }
+
+
+TEST_CASE(PREFIX "noMatch", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(64, 'x');
+    Spanner ss(',');
+    REQUIRE(ss(s.data(), s.data() + s.size()) == 64);
+}
+
+
+TEST_CASE(PREFIX "emptySetNeverMatches", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(64, '\0');
+    Spanner ss;
+    REQUIRE(ss(s.data(), s.data() + s.size()) == 64);
+}
+
+
+TEST_CASE(PREFIX "nulDoesNotTerminate", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(64, 'x');
+    s[3] = '\0';
+    s[40] = ',';
+    Spanner ss(',');
+    REQUIRE(ss(s.data(), s.data() + s.size()) == 40);
+}
+
+
+TEST_CASE(PREFIX "matchAtEachOffset", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    for(int i = 0; i < 64; i++) {
+        std::string s(128, 'x');
+        s[i] = '\n';
+        INFO("i = " << i);
+        Spanner ss(',', '\r', '\n');
+        REQUIRE(ss(s.data(), s.data() + s.size()) == i);
+    }
+}
+
+
+TEST_CASE(PREFIX "matchPos64", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(128, 'x');
+    s[64] = ',';
+    Spanner ss(',');
+    REQUIRE(ss(s.data(), s.data() + s.size()) == 64);
+}
+
+
+TEST_CASE(PREFIX "iteratesCachedMask", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(128, 'x');
+    s[2] = ',';
+    s[9] = ',';
+    s[63] = ',';
+    const char *p = s.data();
+    const char *endp = p + s.size();
+    Spanner ss(',');
+
+    REQUIRE(ss(p, endp) == 2);
+    REQUIRE(ss(p + 3, endp) == 6);
+    REQUIRE(ss(p + 10, endp) == 53);
+    // Exhausted the cached block; rescans from p+64.
+    REQUIRE(ss(p + 64, endp) == 64);
+}
+
+
+TEST_CASE(PREFIX "respectsEndPointer", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(128, 'x');
+    s[20] = ',';
+    const char *p = s.data();
+    Spanner ss(',');
+    REQUIRE(ss(p, p + 20) == 64);
+    ss.reset();
+    REQUIRE(ss(p, p + 21) == 20);
+}
+
+
+TEST_CASE(PREFIX "highBytes", "[bitmaskspanner]")
+{
+    SKIP_UNLESS_SUPPORTED()
+    std::string s(64, '\xff');
+    s[0] = '\x7f';
+    s[5] = '\x80';
+    s[6] = '\x81';
+    Spanner ss('\x80');
+    REQUIRE(ss(s.data(), s.data() + s.size()) == 5);
+}
@@ -0,0 +1,4 @@
+#define MATCHER csvmonkey::ByteMatcherAvx2
+#define KERNEL csvmonkey::kCsmKernelAvx2
+#define PREFIX "avx2_bitmask_spanner_"
+#include "_bitmask_spanner_test.cpp"
@@ -0,0 +1,4 @@
+#define MATCHER csvmonkey::ByteMatcherAvx512
+#define KERNEL csvmonkey::kCsmKernelAvx512
+#define PREFIX "avx512_bitmask_spanner_"
+#include "_bitmask_spanner_test.cpp"
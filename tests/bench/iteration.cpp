@@ -1,14 +1,21 @@
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <chrono>
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
 #include "csvmonkey.hpp"
 
 using csvmonkey::CsvCell;
 using csvmonkey::CsvCursor;
 using csvmonkey::CsvReader;
 using csvmonkey::MappedFileCursor;
+using csvmonkey::kernel_name;
 using std::chrono::duration_cast;
 using std::chrono::high_resolution_clock;
 using std::chrono::microseconds;
@@ -22,13 +29,80 @@ die(const char *msg)
 }
 
 
+/**
+ * Count data TLB read misses on the calling thread, where perf_event_open() is
+ * permitted. Like faults(), this excludes any prefault thread.
+ */
+class TlbCounter
+{
+    int fd_;
+
+    public:
+    TlbCounter()
+        : fd_(-1)
+    {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB
+                    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~TlbCounter()
+    {
+        if(fd_ != -1) {
+            close(fd_);
+        }
+    }
+
+    bool read(long long &count)
+    {
+        return fd_ != -1 && ::read(fd_, &count, sizeof count) == sizeof count;
+    }
+};
+
+
+/**
+ * Page faults taken by the parsing thread, excluding any prefault thread.
+ */
+static long
+faults(long &major)
+{
+    struct rusage ru;
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &ru);
+#else
+    getrusage(RUSAGE_SELF, &ru);
+#endif
+    major = ru.ru_majflt;
+    return ru.ru_minflt;
+}
+
+
 static int
-go(const char *path)
+go(const char *path, int flags)
 {
+    auto now = [&] { return high_resolution_clock::now(); };
+    TlbCounter tlb;
+    long long tlb_start = 0;
+    tlb.read(tlb_start);
+    long major_start;
+    long minor_start = faults(major_start);
+
+    // Timed from before open(), since kCsmMapPopulate reads the file there.
+    auto start = now();
     MappedFileCursor stream;
     CsvReader<MappedFileCursor> reader(stream);
+    stream.open(path, flags);
+    auto opened = now();
 
-    stream.open(path);
     CsvCursor &row = reader.row();
     if(! reader.read_row()) {
         die("Cannot read header row");
@@ -50,10 +124,7 @@ go(const char *path)
         die("Cannot find RecordType column");
     }
 
-    auto now = [&] { return high_resolution_clock::now(); };
     double total = 0.0;
-    auto start = now();
-
     while(reader.read_row()) {
         if(0) {
             if(record_type_cell->equals("LineItem")) {
@@ -65,17 +136,30 @@ go(const char *path)
     }
     auto finish = now();
 
+    long major;
+    long minor = faults(major);
+    long long tlb_end;
+
     printf("Total cost: %lf\n", total);
     auto usec = duration_cast<microseconds>(finish - start).count();
+    auto open_usec = duration_cast<microseconds>(opened - start).count();
 
     struct stat st;
     stat(path, &st);
 
-    std::cout << usec << " us\n";
+    std::cout << kernel_name(reader.kernel()) << " kernel\n";
+    std::cout << usec << " us, " << open_usec << " us in open()\n";
     std::cout << (st.st_size / usec) << " bytes/us\n";
     std::cout << (
         (1e6 / (1024.0 * 1048576.0)) * (double) (st.st_size / usec) 
     ) << " GiB/s\n";
+    std::cout << (minor - minor_start) << " minor faults, "
+              << (major - major_start) << " major faults\n";
+    if(tlb.read(tlb_end)) {
+        std::cout << (tlb_end - tlb_start) << " dTLB read misses\n";
+    } else {
+        std::cout << "dTLB read misses unavailable\n";
+    }
     return 0;
 }
 
@@ -83,10 +167,19 @@ go(const char *path)
 int main(int argc, char **argv)
 {
     const char *path = "ram.csv";
-    if(argc > 1) {
-        path = argv[1];
+    int flags = 0;
+    for(int i = 1; i < argc; i++) {
+        if(! strcmp(argv[i], "--populate")) {
+            flags |= csvmonkey::kCsmMapPopulate;
+        } else if(! strcmp(argv[i], "--hugepages")) {
+            flags |= csvmonkey::kCsmMapHugePages;
+        } else if(! strcmp(argv[i], "--prefault")) {
+            flags |= csvmonkey::kCsmMapPrefault;
+        } else {
+            path = argv[i];
+        }
     }
     for(int i = 0 ; i < 5; i++) {
-        go(path);
+        go(path, flags);
     }
 }
@@ -0,0 +1,381 @@
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+
+
+using csvmonkey::CsvCell;
+
+
+static CsvCell
+make_cell(const std::string &s, bool escaped=false)
+{
+    CsvCell cell;
+    cell.ptr = s.data();
+    cell.size = s.size();
+    cell.escapechar = 0;
+    cell.quotechar = '"';
+    cell.escaped = escaped;
+    return cell;
+}
+
+
+/**
+ * Require as_double() agrees with strtod() bit for bit, and parse_double()
+ * on where the number ends, even when the cell is followed by more digits.
+ */
+static void
+check_double(const std::string &s)
+{
+    INFO("s = " << s);
+    char *expect_end;
+    double expect = strtod(s.c_str(), &expect_end);
+    std::string padded = s + "12345e9";
+    CsvCell cell = make_cell(padded);
+    cell.size = s.size();
+    double got = cell.as_double();
+    if(std::isnan(expect)) {
+        REQUIRE(std::isnan(got));
+    } else {
+        REQUIRE(memcmp(&got, &expect, sizeof got) == 0);
+    }
+
+    const char *end;
+    csvmonkey::parse_double(padded.data(), padded.data() + s.size(), &end);
+    REQUIRE((end - padded.data()) == (expect_end - s.c_str()));
+}
+
+
+TEST_CASE("asDoubleSpecialCases", "[cell]")
+{
+    for(const char *s : {
+        "", "0", "-0", "+0", "0.0", "-0.0", ".", "-", "e5", "abc", "1", "-1",
+        "1.5", "12abc", " \t3.25", "1e", "1e+", "1e-", "1.e3", ".5", "-.5e-1",
+        "1E3", "0.1", "0.2", "0.3", "123456789012345678", "9007199254740993",
+        "9007199254740992.5", "1e22", "1e23", "1.7976931348623157e308",
+        "1.7976931348623159e308", "1e309", "-1e309", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "4.9406564584124654e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+        "1e100000000000", "1e-100000000000", "0e999999",
+        "00000000000000000000000001.5", "0.000000000000000000000000012345",
+        "3.14159265358979323846264338327950288419716939937510",
+        "179769313486231580793728971405303415079934132710037826936173778980444"
+        "968292764750946649017977587207096330286416692887910946555547851940402"
+        "630657488671505820681908902000708383676273854845817711531764475730270"
+        "069855571366959622842914819860834936475292719074168444365510704342711"
+        "559699508093042880177904174497791.9999999999999999999999999999",
+        "7.0420557077594588669468784357561207962098443483187940792729600000e-76",
+        "inf", "-Infinity", "nan", "0x1p3", "-0X10", "0x"
+    }) {
+        check_double(s);
+    }
+}
+
+
+TEST_CASE("asDoubleRandom", "[cell]")
+{
+    std::mt19937_64 rng(1);
+    char buf[64];
+
+    // Round trips of arbitrary doubles at various precisions.
+    for(int i = 0; i < 30000; i++) {
+        uint64_t bits = rng();
+        double d;
+        memcpy(&d, &bits, sizeof d);
+        if(std::isnan(d) || std::isinf(d)) {
+            continue;
+        }
+        for(const char *fmt : {"%.17g", "%.15g", "%.6e", "%.3g"}) {
+            snprintf(buf, sizeof buf, fmt, d);
+            check_double(buf);
+        }
+    }
+
+    // Random digit strings, including more digits than fit in 64 bits.
+    std::uniform_int_distribution<int> ndigits(1, 30);
+    std::uniform_int_distribution<int> digit(0, 9);
+    std::uniform_int_distribution<int> exponent(-360, 330);
+    for(int i = 0; i < 30000; i++) {
+        std::string s;
+        int n = ndigits(rng);
+        int point = (int) (rng() % (n + 1));
+        for(int j = 0; j < n; j++) {
+            if(j == point) {
+                s += '.';
+            }
+            s += (char) ('0' + digit(rng));
+        }
+        if(rng() & 1) {
+            s += "e" + std::to_string(exponent(rng));
+        }
+        check_double(s);
+    }
+}
+
+
+TEST_CASE("asDoubleEscaped", "[cell]")
+{
+    std::string s = "1\"\"5";
+    CsvCell cell = make_cell(s, true);
+    REQUIRE(cell.as_str() == "1\"5");
+    REQUIRE(cell.as_double() == 1.0);
+}
+
+
+TEST_CASE("asInt64", "[cell]")
+{
+    struct {
+        const char *s;
+        csvmonkey::CsmNumberResult result;
+        int64_t value;
+    } cases[] = {
+        {"0", csvmonkey::kCsmNumberOk, 0},
+        {"-0", csvmonkey::kCsmNumberOk, 0},
+        {"+42", csvmonkey::kCsmNumberOk, 42},
+        {"-42", csvmonkey::kCsmNumberOk, -42},
+        {"1234567890123456", csvmonkey::kCsmNumberOk, 1234567890123456LL},
+        {"12345678901234567", csvmonkey::kCsmNumberOk, 12345678901234567LL},
+        {"000000000000000000000000000007", csvmonkey::kCsmNumberOk, 7},
+        {"9223372036854775807", csvmonkey::kCsmNumberOk, INT64_MAX},
+        {"-9223372036854775808", csvmonkey::kCsmNumberOk, INT64_MIN},
+        {"9223372036854775808", csvmonkey::kCsmNumberOverflow, 0},
+        {"-9223372036854775809", csvmonkey::kCsmNumberOverflow, 0},
+        {"99999999999999999999999", csvmonkey::kCsmNumberOverflow, 0},
+        {"", csvmonkey::kCsmNumberInvalid, 0},
+        {"-", csvmonkey::kCsmNumberInvalid, 0},
+        {"12a", csvmonkey::kCsmNumberInvalid, 0},
+        {" 12", csvmonkey::kCsmNumberInvalid, 0},
+        {"1.5", csvmonkey::kCsmNumberInvalid, 0},
+        {"1234567890123456/", csvmonkey::kCsmNumberInvalid, 0},
+    };
+    for(auto &c : cases) {
+        INFO("s = " << c.s);
+        // Followed by digits, which must not be parsed.
+        std::string padded = std::string(c.s) + "123456789012345678";
+        CsvCell cell = make_cell(padded);
+        cell.size = strlen(c.s);
+        int64_t value = -1;
+        REQUIRE(cell.as_int64(value) == c.result);
+        REQUIRE(value == ((c.result == csvmonkey::kCsmNumberOk) ? c.value : -1));
+    }
+
+    std::mt19937_64 rng(1);
+    for(int i = 0; i < 10000; i++) {
+        int64_t n = (int64_t) (rng() >> (rng() % 64));
+        n = (rng() & 1) ? -n : n;
+        std::string s = std::to_string(n);
+        int64_t value = 0;
+        REQUIRE(make_cell(s).as_int64(value) == csvmonkey::kCsmNumberOk);
+        REQUIRE(value == n);
+    }
+}
+
+
+TEST_CASE("asUint64", "[cell]")
+{
+    uint64_t value = 0;
+    REQUIRE(make_cell("18446744073709551615").as_uint64(value)
+            == csvmonkey::kCsmNumberOk);
+    REQUIRE(value == UINT64_MAX);
+    REQUIRE(make_cell("18446744073709551616").as_uint64(value)
+            == csvmonkey::kCsmNumberOverflow);
+    REQUIRE(make_cell("-1").as_uint64(value) == csvmonkey::kCsmNumberOverflow);
+    REQUIRE(make_cell("-0").as_uint64(value) == csvmonkey::kCsmNumberOk);
+    REQUIRE(value == 0);
+    REQUIRE(make_cell("x").as_uint64(value) == csvmonkey::kCsmNumberInvalid);
+
+    std::string s = "1\"\"2";
+    REQUIRE(make_cell(s, true).as_uint64(value) == csvmonkey::kCsmNumberInvalid);
+}
+
+
+#ifdef CSM_X86
+TEST_CASE("parseDigitsSse42", "[cell]")
+{
+    if(! csvmonkey::kernel_supported(csvmonkey::kCsmKernelSse42)) {
+        WARN("SSE4.2 unsupported, parse_digits_sse42() not tested");
+        return;
+    }
+
+    // Digit runs of every length up to and beyond one vector, ending either
+    // at a non-digit or exactly at the end of the allocation.
+    std::mt19937_64 rng(1);
+    for(size_t len = 0; len < 40; len++) {
+        for(int i = 0; i < 100; i++) {
+            std::unique_ptr<char[]> buf(new char[len]);
+            for(size_t j = 0; j < len; j++) {
+                buf[j] = (char) ('0' + (rng() % 10));
+            }
+            if(len && (i & 1)) {
+                buf[rng() % len] = "/:x\0"[rng() % 4];
+            }
+            INFO("s = " << std::string(buf.get(), len));
+
+            const char *endp = buf.get() + len;
+            const char *expect_p = buf.get();
+            uint64_t expect = 0;
+            bool expect_ok = csvmonkey::parse_digits_tail(expect_p, endp, expect);
+            const char *p = buf.get();
+            uint64_t value = 0;
+            REQUIRE(csvmonkey::parse_digits_sse42(p, endp, value) == expect_ok);
+            REQUIRE((p - buf.get()) == (expect_p - buf.get()));
+            if(expect_ok) {
+                REQUIRE(value == expect);
+            }
+        }
+    }
+}
+#endif // CSM_X86
+
+
+TEST_CASE("asDecimal", "[cell]")
+{
+    struct {
+        const char *s;
+        int scale;
+        csvmonkey::CsmNumberResult result;
+        int64_t value;
+    } cases[] = {
+        {"0", 2, csvmonkey::kCsmNumberOk, 0},
+        {"12.34", 2, csvmonkey::kCsmNumberOk, 1234},
+        {"-12.34", 4, csvmonkey::kCsmNumberOk, -123400},
+        {"+.5", 1, csvmonkey::kCsmNumberOk, 5},
+        {"7.", 3, csvmonkey::kCsmNumberOk, 7000},
+        {"12.3400000000000000000000", 2, csvmonkey::kCsmNumberOk, 1234},
+        {"0.0000000001", 10, csvmonkey::kCsmNumberOk, 1},
+        {"12345678.1234567890", 10, csvmonkey::kCsmNumberOk, 123456781234567890LL},
+        {"922337203.6854775807", 10, csvmonkey::kCsmNumberOk, INT64_MAX},
+        {"-922337203.6854775808", 10, csvmonkey::kCsmNumberOk, INT64_MIN},
+        {"922337203.6854775808", 10, csvmonkey::kCsmNumberOverflow, 0},
+        {"0.123456789012345678", 18, csvmonkey::kCsmNumberOk, 123456789012345678LL},
+        {"12", 0, csvmonkey::kCsmNumberOk, 12},
+        {"1.2", 0, csvmonkey::kCsmNumberOverflow, 0},
+        {"12.345", 2, csvmonkey::kCsmNumberOverflow, 0},
+        {"1", 19, csvmonkey::kCsmNumberOverflow, 0},
+        {"100000000000000000000", 0, csvmonkey::kCsmNumberOverflow, 0},
+        {"", 2, csvmonkey::kCsmNumberInvalid, 0},
+        {".", 2, csvmonkey::kCsmNumberInvalid, 0},
+        {"-", 2, csvmonkey::kCsmNumberInvalid, 0},
+        {"1.2.3", 2, csvmonkey::kCsmNumberInvalid, 0},
+        {"1e5", 2, csvmonkey::kCsmNumberInvalid, 0},
+        {"1.00x", 2, csvmonkey::kCsmNumberInvalid, 0},
+    };
+    for(auto &c : cases) {
+        INFO("s = " << c.s << ", scale = " << c.scale);
+        std::string padded = std::string(c.s) + "123456789012345678";
+        CsvCell cell = make_cell(padded);
+        cell.size = strlen(c.s);
+        int64_t value = -1;
+        REQUIRE(cell.as_decimal(c.scale, value) == c.result);
+        REQUIRE(value == ((c.result == csvmonkey::kCsmNumberOk) ? c.value : -1));
+    }
+
+    // Sums of money amounts are exact.
+    int64_t total = 0;
+    for(int i = 0; i < 10; i++) {
+        int64_t value;
+        REQUIRE(make_cell("0.1000000000").as_decimal(10, value)
+                == csvmonkey::kCsmNumberOk);
+        total += value;
+    }
+    REQUIRE(total == 10000000000LL);
+}
+
+
+TEST_CASE("asTimestamp", "[cell]")
+{
+    struct {
+        const char *s;
+        int64_t value;
+    } valid[] = {
+        {"1970-01-01", 0},
+        {"1970-01-01 00:00:00", 0},
+        {"2017-01-02 03:04:05", 1483326245000000LL},
+        {"2017-01-02T03:04:05", 1483326245000000LL},
+        {"2017-01-02T03:04:05Z", 1483326245000000LL},
+        {"2017-01-02 03:04", 1483326240000000LL},
+        {"2017-01-02 03:04Z", 1483326240000000LL},
+        {"2017-01-02T03:04:05.5", 1483326245500000LL},
+        {"2017-01-02T03:04:05,123456Z", 1483326245123456LL},
+        {"2017-01-02T03:04:05.123456789", 1483326245123456LL},
+        {"2017-01-02T03:04:05+01:00", 1483322645000000LL},
+        {"2017-01-02T03:04:05-0130", 1483331645000000LL},
+        {"2017-01-02T03:04:05.25+05", 1483308245250000LL},
+        {"1969-12-31 23:59:59.999999", -1},
+        {"2000-02-29 12:00:00", 951825600000000LL},
+        {"0001-01-01 00:00:00", -62135596800000000LL},
+        {"9999-12-31 23:59:59", 253402300799000000LL},
+    };
+    for(auto &c : valid) {
+        INFO("s = " << c.s);
+        // Followed by more timestamp-like bytes, which must not be parsed.
+        std::string padded = std::string(c.s) + ":00.000000Z";
+        CsvCell cell = make_cell(padded);
+        cell.size = strlen(c.s);
+        int64_t value = 0;
+        REQUIRE(cell.as_timestamp(value) == csvmonkey::kCsmNumberOk);
+        REQUIRE(value == c.value);
+    }
+
+    for(const char *s : {
+        "", "2017", "2017-01", "2017-1-02", "2017-01-02 ", "2017-01-02T",
+        "2017-01-02 03", "2017-01-02 3:04:05", "2017-01-02 03:04:5",
+        "2017-01-02 03:04:05.", "2017-01-02 03:04:05.1234567890",
+        "2017-01-02 03:04:05+1", "2017-01-02 03:04:05+01:0",
+        "2017-01-02 03:04:05 ", "2017-01-02_03:04:05", "2017/01/02 03:04:05",
+        "2017-13-02 03:04:05", "2017-00-02 03:04:05", "2017-01-32 03:04:05",
+        "2017-02-29 03:04:05", "1900-02-29", "2017-01-02 24:00:00",
+        "2017-01-02 23:60:00", "2017-01-02 23:59:60", "2017-01-02 03:04:05+24",
+        "2017-01-02Z"
+    }) {
+        INFO("s = " << s);
+        int64_t value = -1;
+        REQUIRE(make_cell(s).as_timestamp(value) == csvmonkey::kCsmNumberInvalid);
+        REQUIRE(value == -1);
+    }
+
+    // NULs in digit positions are not digits.
+    std::string nul("2017-01-02 0\0:04:05", 19);
+    int64_t value = 0;
+    REQUIRE(make_cell(nul).as_timestamp(value) == csvmonkey::kCsmNumberInvalid);
+
+#ifdef CSM_X86
+    if(csvmonkey::kernel_supported(csvmonkey::kCsmKernelSse42)) {
+        int year, month, day, hour, minute;
+        REQUIRE(csvmonkey::parse_timestamp_prefix_sse42("2017-11-02T23:54",
+                year, month, day, hour, minute));
+        REQUIRE(year == 2017);
+        REQUIRE(month == 11);
+        REQUIRE(day == 2);
+        REQUIRE(hour == 23);
+        REQUIRE(minute == 54);
+        for(const char *s : {"2017-11-02_23:54", "2017/11/02 23:54",
+                             "2017-11-02 23-54", "2017-11-0x 23:54"}) {
+            INFO("s = " << s);
+            REQUIRE(! csvmonkey::parse_timestamp_prefix_sse42(s,
+                year, month, day, hour, minute));
+        }
+    }
+#endif
+
+    // Agrees with timegm().
+    std::mt19937_64 rng(1);
+    char buf[64];
+    for(int i = 0; i < 10000; i++) {
+        time_t t = (time_t) (rng() % 253402300800LL);
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(buf, sizeof buf, (i & 1) ? "%Y-%m-%d %H:%M:%S" : "%Y-%m-%dT%H:%M:%SZ", &tm);
+        INFO("s = " << buf);
+        REQUIRE(make_cell(buf).as_timestamp(value) == csvmonkey::kCsmNumberOk);
+        REQUIRE(value == (int64_t) t * 1000000);
+    }
+}
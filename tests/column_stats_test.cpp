@@ -0,0 +1,187 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+#include "temp_file.hpp"
+
+
+using csvmonkey::ColumnBlockStats;
+using csvmonkey::ColumnStatsIndex;
+using csvmonkey::CsvReader;
+using csvmonkey::MappedFileCursor;
+
+
+static void
+add(ColumnBlockStats &stats, const std::string &s)
+{
+    stats.add(s.data(), s.size());
+}
+
+
+TEST_CASE("columnBlockStatsNumeric", "[columnstats]")
+{
+    ColumnBlockStats stats;
+    for(const char *s : {"3.5", "", "-2", "10"}) {
+        add(stats, s);
+    }
+
+    REQUIRE(stats.numeric);
+    REQUIRE(stats.nulls == 1);
+    REQUIRE(stats.values == 3);
+    REQUIRE(stats.min == -2);
+    REQUIRE(stats.max == 10);
+    REQUIRE(stats.may_overlap(9, 20));
+    REQUIRE(! stats.may_overlap(11, 20));
+    REQUIRE(! stats.may_overlap(-5, -3));
+
+    add(stats, "abc");
+    REQUIRE(! stats.numeric);
+    REQUIRE(stats.may_overlap(11, 20));
+
+    // Cells are parsed only up to their end.
+    std::string row = "1234";
+    ColumnBlockStats bounded;
+    bounded.add(row.data(), 2);
+    REQUIRE(bounded.numeric);
+    REQUIRE(bounded.max == 12);
+}
+
+
+TEST_CASE("columnBlockStatsNonFinite", "[columnstats]")
+{
+    // NaN previously became min and max, so matching blocks were skipped.
+    for(const char *bad : {"nan", "NaN", "inf", "-infinity", "1e999"}) {
+        INFO("bad = " << bad);
+        ColumnBlockStats first;
+        add(first, bad);
+        add(first, "5");
+        REQUIRE(! first.numeric);
+        REQUIRE(first.may_overlap(4, 6));
+
+        ColumnBlockStats last;
+        add(last, "5");
+        add(last, bad);
+        REQUIRE(! last.numeric);
+        REQUIRE(last.may_overlap(4, 6));
+    }
+}
+
+
+TEST_CASE("columnBlockStatsStrings", "[columnstats]")
+{
+    ColumnBlockStats stats;
+    REQUIRE(! stats.may_equal("x"));
+    REQUIRE(! stats.may_equal(""));
+
+    for(const char *s : {"LineItem", "Rounding", "InvoiceTotal"}) {
+        add(stats, s);
+    }
+    REQUIRE(stats.min_str == "InvoiceTotal");
+    REQUIRE(stats.max_str == "Rounding");
+    REQUIRE(stats.may_equal("LineItem"));
+    REQUIRE(! stats.may_equal("AccountTotal"));
+    REQUIRE(! stats.may_equal("Tax"));
+    REQUIRE(! stats.may_equal(""));
+
+    add(stats, std::string(ColumnBlockStats::kMaxStringBytes + 1, 'z'));
+    REQUIRE(! stats.string_range);
+    REQUIRE(stats.may_equal("Tax"));
+}
+
+
+TEST_CASE("columnBlockStatsDistinct", "[columnstats]")
+{
+    ColumnBlockStats few;
+    for(int i = 0; i < 1000; i++) {
+        add(few, std::to_string(i % 5));
+    }
+    REQUIRE(few.distinct() > 4);
+    REQUIRE(few.distinct() < 6);
+
+    ColumnBlockStats many;
+    for(int i = 0; i < 20000; i++) {
+        add(many, std::to_string(i));
+    }
+    REQUIRE(many.distinct() > 14000);
+    REQUIRE(many.distinct() < 26000);
+}
+
+
+TEST_CASE("columnStatsIndex", "[columnstats]")
+{
+    std::string s = "RecordType,Cost,Note\n";
+    for(int i = 0; i < 100; i++) {
+        const char *type = (i < 50) ? "LineItem" : "Rounding";
+        s += std::string(type) + "," + std::to_string(i) + ",\"a,\"\"b\"\"\"\n";
+    }
+    s += "Tax,5\n";
+    TempFile file(s);
+    std::string stats_path = ColumnStatsIndex::sidecar_path(file.path);
+
+    MappedFileCursor stream;
+    stream.open(file.path.c_str());
+    CsvReader<MappedFileCursor> reader(stream);
+    REQUIRE(reader.read_row());
+
+    ColumnStatsIndex built;
+    built.build(stream, 40);
+    built.save(stats_path);
+
+    ColumnStatsIndex stats;
+    REQUIRE(stats.load(stats_path, stream));
+    REQUIRE(! ColumnStatsIndex(';').load(stats_path, stream));
+    REQUIRE(stats.blocks() == 3);
+    REQUIRE(stats.columns() == 3);
+    REQUIRE(stats.block_rows(2) == 21);
+    REQUIRE(stats.column(2, 2).nulls == 1);
+    REQUIRE(stats.column(0, 2).min_str == "a,\"b\"");
+
+    // Only blocks that may contain a match are read.
+    std::vector<size_t> matched;
+    for(size_t i = 0; i < stats.blocks(); i++) {
+        if(! (stats.column(i, 0).may_equal("Rounding") &&
+              stats.column(i, 1).may_overlap(45, 55))) {
+            continue;
+        }
+
+        stream.seek(stats.block_offset(i));
+        reader.reset();
+        for(size_t j = 0; j < stats.block_rows(i); j++) {
+            REQUIRE(reader.read_row());
+            auto &row = reader.row();
+            if(row.cells[0].equals("Rounding") &&
+                    row.cells[1].as_double() >= 45 &&
+                    row.cells[1].as_double() <= 55) {
+                matched.push_back((size_t) row.cells[1].as_double());
+            }
+        }
+    }
+    REQUIRE(matched == std::vector<size_t>({50, 51, 52, 53, 54, 55}));
+
+    // Sidecars with invalid flags, or claiming more entries than they hold.
+    std::ifstream in(stats_path, std::ios::binary);
+    std::string sidecar((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+    std::string bad_flag(sidecar);
+    bad_flag[90] = 2;
+    TempFile bad_flag_file(bad_flag);
+    REQUIRE_THROWS_AS(stats.load(bad_flag_file.path, stream),
+                      csvmonkey::Error &);
+    uint64_t count = 1ULL << 60;
+    for(size_t offset : {42, 66}) {
+        std::string oversized(sidecar);
+        oversized.replace(offset, sizeof count, (const char *) &count,
+                          sizeof count);
+        TempFile oversized_file(oversized);
+        REQUIRE_THROWS_AS(stats.load(oversized_file.path, stream),
+                          csvmonkey::Error &);
+    }
+    REQUIRE(stats.blocks() == 3);
+
+    unlink(stats_path.c_str());
+}
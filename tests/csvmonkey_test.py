@@ -1,4 +1,7 @@
 
+import os
+import shutil
+import tempfile
 import unittest
 
 import csvmonkey
@@ -46,6 +49,79 @@ class RowTest(unittest.TestCase):
         self.assertRaises(KeyError, lambda: row["missing"])
 
 
+class FromPathsTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def path(self, name, s):
+        path = os.path.join(self.dir, name)
+        with open(path, 'wb') as fp:
+            fp.write(s)
+        return path
+
+    def test_header_dedup(self):
+        paths = [self.path('1.csv', b'a,b\n1,2\n'),
+                 self.path('2.csv', b'a,b\n3,4\n')]
+        reader = csvmonkey.from_paths(paths, yields='tuple', header=True)
+        self.assertEquals([('1', '2'), ('3', '4')], list(reader))
+
+    def test_header_mismatch(self):
+        paths = [self.path('1.csv', b'a,b\n1,2\n'),
+                 self.path('2.csv', b'a,c\n3,4\n')]
+        reader = csvmonkey.from_paths(paths, yields='tuple', header=True)
+        self.assertEquals(('1', '2'), next(reader))
+        self.assertRaises(IOError, lambda: next(reader))
+
+
+class ReadAheadTest(unittest.TestCase):
+    def test_rows(self):
+        reader = csvmonkey.from_iter(iter([b'a,b\n1,2\n3,4\n']),
+                                     yields='tuple', header=True,
+                                     read_ahead=True)
+        self.assertEquals([('1', '2'), ('3', '4')], list(reader))
+
+    def test_iter_error(self):
+        def gen():
+            yield b'a,b\n1,2\n'
+            raise ValueError('boom')
+        reader = csvmonkey.from_iter(gen(), yields='tuple', read_ahead=True)
+        self.assertRaises(ValueError, lambda: list(reader))
+
+    def test_file_error(self):
+        class File(object):
+            def __init__(self):
+                self.reads = 0
+
+            def read(self, n):
+                self.reads += 1
+                if self.reads > 1:
+                    raise OSError('read failed')
+                return b'a,b\n1,2\n'
+
+        reader = csvmonkey.from_file(File(), yields='tuple', read_ahead=True)
+        self.assertRaises(OSError, lambda: list(reader))
+
+
+class TimestampTest(unittest.TestCase):
+    def test_as_timestamp(self):
+        reader = csvmonkey.from_iter(iter([
+            b'date\n'
+            b'2017-01-02 03:04:05\n'
+            b'2017-01-02T03:04:05.25+01:00\n'
+            b'bogus\n'
+        ]), header=True)
+        cell = reader.find_cell('date')
+        next(reader)
+        self.assertEquals(1483326245000000, cell.as_timestamp())
+        next(reader)
+        self.assertEquals(1483322645250000, cell.as_timestamp())
+        next(reader)
+        self.assertRaises(ValueError, cell.as_timestamp)
+
+
 
 
 if __name__ == '__main__':
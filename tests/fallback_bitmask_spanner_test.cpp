@@ -0,0 +1,4 @@
+#define MATCHER csvmonkey::ByteMatcherFallback
+#define KERNEL csvmonkey::kCsmKernelFallback
+#define PREFIX "fallback_bitmask_spanner_"
+#include "_bitmask_spanner_test.cpp"
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+#include "temp_file.hpp"
+
+
+using csvmonkey::CsvReader;
+using csvmonkey::CsvRowBatch;
+using csvmonkey::CsvRowSpan;
+using csvmonkey::MappedFileCursor;
+using csvmonkey::ParallelCsvReader;
+using Rows = std::vector<std::vector<std::string>>;
+
+
+static void
+append_batch(Rows &rows, CsvRowBatch &batch)
+{
+    for(size_t i = 0; i < batch.rows(); i++) {
+        csvmonkey::CsvRow row = batch.row(i);
+        std::vector<std::string> cells;
+        for(size_t j = 0; j < row.count; j++) {
+            cells.push_back(row.cells[j].as_str());
+        }
+        rows.push_back(cells);
+    }
+}
+
+
+static Rows
+read_sequential(const std::string &path, bool yield_incomplete_row=false)
+{
+    MappedFileCursor stream;
+    stream.open(path.c_str());
+    CsvReader<MappedFileCursor> reader(stream, ',', '"', 0,
+                                       yield_incomplete_row);
+
+    Rows rows;
+    auto &row = reader.row();
+    while(reader.read_row()) {
+        std::vector<std::string> cells;
+        for(size_t i = 0; i < row.count; i++) {
+            cells.push_back(row.cells[i].as_str());
+        }
+        rows.push_back(cells);
+    }
+    return rows;
+}
+
+
+static Rows
+read_parallel(const std::string &path, size_t threads, size_t chunk_size,
+              bool ordered, bool two_stage, bool yield_incomplete_row=false,
+              bool speculative=true, size_t window=64 << 10,
+              size_t *rescans=0)
+{
+    MappedFileCursor stream;
+    stream.open(path.c_str());
+    ParallelCsvReader reader(stream, ',', '"', yield_incomplete_row);
+    reader.set_threads(threads);
+    reader.set_chunk_size(chunk_size);
+    reader.set_ordered(ordered);
+    reader.set_two_stage(two_stage);
+    reader.set_speculative(speculative);
+    reader.set_window(window);
+
+    std::vector<CsvRowBatch> batches;
+    CsvRowBatch batch;
+    size_t last_seq = 0;
+    while(reader.read_batch(batch)) {
+        if(ordered && batches.size()) {
+            REQUIRE(batch.seq == last_seq + 1);
+        }
+        last_seq = batch.seq;
+        batches.push_back(std::move(batch));
+    }
+
+    std::sort(batches.begin(), batches.end(),
+        [](const CsvRowBatch &a, const CsvRowBatch &b) {
+            return a.seq < b.seq;
+        });
+
+    Rows rows;
+    for(auto &batch : batches) {
+        append_batch(rows, batch);
+    }
+    if(rescans) {
+        *rescans = reader.rescans();
+    }
+    return rows;
+}
+
+
+static std::string
+make_input()
+{
+    std::string s = "a,b,c\n";
+    for(int i = 0; i < 500; i++) {
+        std::string n = std::to_string(i);
+        switch(i % 5) {
+        case 0:
+            s += n + ",plain," + n + "\n";
+            break;
+        case 1:
+            s += n + ",\"quoted, with\nnewline\",x\r\n";
+            break;
+        case 2:
+            s += "\"" + n + "\",\"say \"\"hi\"\"\n\n\",\n";
+            break;
+        case 3:
+            s += n + "," + std::string(i, 'z') + ",\"" + std::string(i, '\n') + "\"\n";
+            break;
+        case 4:
+            s += "\n" + n + ",,\n";
+            break;
+        }
+    }
+    return s;
+}
+
+
+TEST_CASE("parallelMatchesSequential", "[parallel]")
+{
+    TempFile file(make_input());
+    Rows expect = read_sequential(file.path);
+    REQUIRE(expect.size() == 501);
+
+    for(size_t chunk_size : {13, 64, 4096, 1 << 20}) {
+        INFO("chunk_size = " << chunk_size);
+        for(size_t threads : {1, 4}) {
+            INFO("threads = " << threads);
+            for(int two_stage = 0; two_stage < 2; two_stage++) {
+                INFO("two_stage = " << two_stage);
+                for(int speculative = 0; speculative < 2; speculative++) {
+                    INFO("speculative = " << speculative);
+                    for(int ordered = 0; ordered < 2; ordered++) {
+                        INFO("ordered = " << ordered);
+                        REQUIRE(read_parallel(file.path, threads, chunk_size,
+                                              ordered, two_stage, false,
+                                              speculative) == expect);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+TEST_CASE("parallelIncompleteFinalRow", "[parallel]")
+{
+    TempFile file("a,b\nc,\"d\ne\"\nf,g");
+    Rows expect = read_sequential(file.path, true);
+    REQUIRE(expect.size() == 3);
+
+    for(size_t chunk_size : {1, 3, 64}) {
+        INFO("chunk_size = " << chunk_size);
+        for(int speculative = 0; speculative < 2; speculative++) {
+            INFO("speculative = " << speculative);
+            REQUIRE(read_parallel(file.path, 2, chunk_size, true, false, true,
+                                  speculative) == expect);
+        }
+    }
+}
+
+
+TEST_CASE("parallelSettersAfterStart", "[parallel]")
+{
+    TempFile file("a\n");
+    MappedFileCursor stream;
+    stream.open(file.path.c_str());
+    ParallelCsvReader reader(stream);
+
+    CsvRowBatch batch;
+    REQUIRE(reader.read_batch(batch));
+    REQUIRE_THROWS_AS(reader.set_threads(2), csvmonkey::Error &);
+    REQUIRE(! reader.read_batch(batch));
+}
+
+
+TEST_CASE("parallelRescansMisspeculation", "[parallel]")
+{
+    // Quoted fields far longer than the speculation window, containing no
+    // quotes, are wrongly assumed to fall outside quotes.
+    std::string s;
+    for(int i = 0; i < 20; i++) {
+        s += std::to_string(i) + ",\"";
+        for(int j = 0; j < 500; j++) {
+            s += (j % 7) ? "x," : "y\n";
+        }
+        s += "\"\n";
+    }
+
+    TempFile file(s);
+    Rows expect = read_sequential(file.path);
+    REQUIRE(expect.size() == 20);
+
+    for(size_t chunk_size : {100, 1000, 5000}) {
+        INFO("chunk_size = " << chunk_size);
+        size_t rescans = 0;
+        REQUIRE(read_parallel(file.path, 3, chunk_size, true, false, false,
+                              true, 16, &rescans) == expect);
+        REQUIRE(rescans > 0);
+    }
+}
+
+
+TEST_CASE("speculatorQuotedAt", "[parallel]")
+{
+    std::string s = "a,\"b,c\nd\",e\n\"f\"\"g\",h\n";
+    csvmonkey::RecordSpeculator speculator(s.data(), s.data() + s.size());
+
+    // Inside "b,c\nd", identified by the opening quote.
+    REQUIRE(speculator.quoted_at(s.data() + 4));
+    REQUIRE(speculator.quoted_at(s.data() + 7));
+    // After the closing quote.
+    REQUIRE(! speculator.quoted_at(s.data() + 11));
+    // Inside "f""g", following an escaped quote.
+    REQUIRE(speculator.quoted_at(s.data() + 17));
+
+    // The first record boundary following offset 4 skips the quoted newline.
+    REQUIRE(speculator.speculate(s.data() + 4) == s.data() + 12);
+    REQUIRE(speculator.speculate(s.data()) == s.data());
+}
+
+
+TEST_CASE("forEachBatch", "[parallel]")
+{
+    TempFile file(make_input());
+    Rows expect = read_sequential(file.path);
+
+    for(size_t batch_size : {1, 7, 1024}) {
+        INFO("batch_size = " << batch_size);
+        for(size_t threads : {1, 4}) {
+            INFO("threads = " << threads);
+            MappedFileCursor stream;
+            stream.open(file.path.c_str());
+            ParallelCsvReader reader(stream);
+            reader.set_threads(threads);
+            reader.set_chunk_size(4096);
+            reader.set_batch_size(batch_size);
+
+            // Catch assertions are not thread safe, so only collect results
+            // from within the callback.
+            std::mutex mutex;
+            std::map<std::pair<size_t, size_t>, Rows> spans;
+            size_t max_rows = 0;
+            reader.for_each_batch([&](CsvRowSpan &span) {
+                Rows rows;
+                for(size_t i = 0; i < span.rows(); i++) {
+                    csvmonkey::CsvRow row = span.row(i);
+                    std::vector<std::string> cells;
+                    for(size_t j = 0; j < row.count; j++) {
+                        cells.push_back(row.cells[j].as_str());
+                    }
+                    rows.push_back(cells);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                spans[std::make_pair(span.seq(), span.offset())] = rows;
+                max_rows = std::max(max_rows, span.rows());
+            });
+
+            REQUIRE(max_rows <= batch_size);
+            Rows got;
+            for(auto &it : spans) {
+                got.insert(got.end(), it.second.begin(), it.second.end());
+            }
+            REQUIRE(got == expect);
+        }
+    }
+}
+
+
+TEST_CASE("forEachBatchRethrows", "[parallel]")
+{
+    TempFile file(make_input());
+    MappedFileCursor stream;
+    stream.open(file.path.c_str());
+    ParallelCsvReader reader(stream);
+    reader.set_threads(2);
+    reader.set_chunk_size(1024);
+
+    REQUIRE_THROWS_AS(
+        reader.for_each_batch([](CsvRowSpan &) {
+            throw csvmonkey::Error("test", "callback failed");
+        }),
+        csvmonkey::Error &
+    );
+}
+
+
+TEST_CASE("workStealingPool", "[parallel]")
+{
+    std::atomic<size_t> sum(0);
+    {
+        csvmonkey::WorkStealingPool pool(4);
+        for(size_t i = 1; i <= 1000; i++) {
+            pool.submit([&sum, i] {
+                if(i == 1) {
+                    // One slow task should not delay the remainder.
+                    usleep(10000);
+                }
+                sum += i;
+            });
+        }
+        pool.wait();
+    }
+    REQUIRE(sum == 500500);
+}
+
+
+TEST_CASE("workStealingPoolIdle", "[parallel]")
+{
+    csvmonkey::WorkStealingPool pool(4);
+    pool.submit([] { usleep(100000); });
+    clock_t start = clock();
+    pool.wait();
+    usleep(100000);
+    // Threads without work should sleep rather than spin.
+    REQUIRE((clock() - start) < CLOCKS_PER_SEC / 20);
+}
+
+
+TEST_CASE("parallelProjection", "[parallel]")
+{
+    TempFile file(make_input());
+    Rows full = read_sequential(file.path);
+
+    MappedFileCursor stream;
+    stream.open(file.path.c_str());
+    ParallelCsvReader reader(stream);
+    reader.set_threads(3);
+    reader.set_chunk_size(512);
+    reader.set_columns({1});
+
+    Rows got;
+    CsvRowBatch batch;
+    while(reader.read_batch(batch)) {
+        for(size_t i = 0; i < batch.rows(); i++) {
+            csvmonkey::CsvRow row = batch.row(i);
+            REQUIRE(row.count <= 2);
+            got.push_back({row.cells[1].as_str()});
+        }
+    }
+
+    REQUIRE(got.size() == full.size());
+    for(size_t i = 0; i < full.size(); i++) {
+        REQUIRE(got[i][0] == full[i][1]);
+    }
+}
@@ -0,0 +1,305 @@
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+
+
+using csvmonkey::CsvReader;
+using Rows = std::vector<std::vector<std::string>>;
+
+
+/**
+ * StreamCursor over a string, padded with NULs as required by StreamCursor.
+ */
+class StringCursor
+    : public csvmonkey::StreamCursor
+{
+    std::string s_;
+    size_t pos_;
+
+    public:
+    StringCursor(const std::string &s)
+        : s_(s + std::string(64, '\0'))
+        , pos_(0)
+    {
+    }
+
+    const char *buf() { return &s_[pos_]; }
+    size_t size() { return s_.size() - 64 - pos_; }
+    void consume(size_t n) { pos_ += std::min(n, size()); }
+    bool fill() { return false; }
+};
+
+
+/**
+ * BufferedStreamCursor that receives a string in small chunks, to exercise
+ * fill() and records spanning reads.
+ */
+class ChunkedCursor
+    : public csvmonkey::BufferedStreamCursor
+{
+    std::string s_;
+    size_t chunk_;
+    size_t pos_;
+
+    public:
+    ChunkedCursor(const std::string &s, size_t chunk)
+        : s_(s)
+        , chunk_(chunk)
+        , pos_(0)
+    {
+    }
+
+    ssize_t readmore()
+    {
+        size_t n = std::min(chunk_, s_.size() - pos_);
+        if(! n) {
+            return -1;
+        }
+        ensure(n);
+        memcpy(&vec_[write_pos_], &s_[pos_], n);
+        pos_ += n;
+        return n;
+    }
+};
+
+
+/**
+ * Return every row of `cursor`, or if `columns` is nonempty, only those
+ * columns present in each row.
+ */
+template<class Cursor>
+static Rows
+read_all(Cursor &cursor, bool two_stage,
+         csvmonkey::CsmKernel kernel=csvmonkey::kCsmKernelAuto,
+         const std::vector<size_t> &columns={})
+{
+    CsvReader<Cursor> reader(cursor);
+    reader.set_kernel(kernel);
+    reader.set_two_stage(two_stage);
+    reader.set_columns(columns);
+
+    Rows rows;
+    auto &row = reader.row();
+    while(reader.read_row()) {
+        std::vector<std::string> cells;
+        if(columns.empty()) {
+            for(size_t i = 0; i < row.count; i++) {
+                cells.push_back(row.cells[i].as_str());
+            }
+        }
+        for(size_t i : columns) {
+            if(i < row.count) {
+                cells.push_back(row.cells[i].as_str());
+            }
+        }
+        rows.push_back(cells);
+    }
+    return rows;
+}
+
+
+static void
+check(const std::string &s, const Rows &expect)
+{
+    for(int k = csvmonkey::kCsmKernelFallback; k <= csvmonkey::kCsmKernelAvx512; k++) {
+        auto kernel = (csvmonkey::CsmKernel) k;
+        if(! csvmonkey::kernel_supported(kernel)) {
+            continue;
+        }
+
+        INFO("kernel = " << csvmonkey::kernel_name(kernel));
+        for(int two_stage = 0; two_stage < 2; two_stage++) {
+            INFO("two_stage = " << two_stage);
+            StringCursor cursor(s);
+            REQUIRE(read_all(cursor, two_stage, kernel) == expect);
+
+            for(size_t chunk : {1, 7, 64}) {
+                INFO("chunk = " << chunk);
+                ChunkedCursor chunked(s, chunk);
+                REQUIRE(read_all(chunked, two_stage, kernel) == expect);
+            }
+        }
+    }
+}
+
+
+TEST_CASE("unquoted", "[reader]")
+{
+    check("a,b,c\nd,e,f\n", {{"a", "b", "c"}, {"d", "e", "f"}});
+}
+
+
+TEST_CASE("emptyCells", "[reader]")
+{
+    check(",a,,b,\n", {{"", "a", "", "b", ""}});
+}
+
+
+TEST_CASE("blankLinesAndCrlf", "[reader]")
+{
+    check("\r\na,b\r\n\r\n\nc,d\r\n", {{"a", "b"}, {"c", "d"}});
+}
+
+
+TEST_CASE("quoted", "[reader]")
+{
+    check("\"a,b\",\"c\nd\",\"\"\n\"x\"\"y\",z\n", {
+        {"a,b", "c\nd", ""},
+        {"x\"y", "z"},
+    });
+}
+
+
+TEST_CASE("wideRow", "[reader]")
+{
+    std::string s;
+    std::vector<std::string> expect;
+    for(int i = 0; i < 100; i++) {
+        expect.push_back(std::to_string(i));
+        s += (i ? "," : "") + expect.back();
+    }
+    s += "\n";
+    check(s, {expect});
+}
+
+
+TEST_CASE("wideRowRestartsWithinBlock", "[reader]")
+{
+    // Growing the cell array restarts the row, which must not reuse spanner
+    // state from beyond its start.
+    std::string s = "a,b";
+    std::vector<std::string> expect = {"a", "b"};
+    for(int i = 0; i < 40; i++) {
+        s += ",\"" + std::to_string(i) + "\"";
+        expect.push_back(std::to_string(i));
+    }
+    s += "\n";
+    check(s, {expect});
+}
+
+
+TEST_CASE("longCells", "[reader]")
+{
+    std::string a(1000, 'a');
+    std::string b(999, 'b');
+    check(a + ",\"" + b + "\"\n" + b + "\n", {{a, b}, {b}});
+}
+
+
+TEST_CASE("twoStageRecordSpansIndexBlocks", "[reader]")
+{
+    std::string big(3 * csvmonkey::StructuralIndex::kBlockSize, 'x');
+    std::string s = "a,b\n\"" + big + "\",c\nd\n";
+    StringCursor cursor(s);
+    REQUIRE(read_all(cursor, true) == Rows({{"a", "b"}, {big, "c"}, {"d"}}));
+}
+
+
+TEST_CASE("twoStageRejectsEscapechar", "[reader]")
+{
+    StringCursor cursor("a\n");
+    CsvReader<StringCursor> reader(cursor, ',', '"', '\\');
+    REQUIRE_THROWS_AS(reader.set_two_stage(true), csvmonkey::Error &);
+}
+
+
+TEST_CASE("kernelSelection", "[reader]")
+{
+    StringCursor cursor("a\n");
+    CsvReader<StringCursor> reader(cursor);
+    REQUIRE(reader.kernel() != csvmonkey::kCsmKernelAuto);
+
+    reader.set_kernel(csvmonkey::kCsmKernelFallback);
+    REQUIRE(reader.kernel() == csvmonkey::kCsmKernelFallback);
+    REQUIRE(reader.read_row());
+    REQUIRE(reader.row().cells[0].as_str() == "a");
+}
+
+
+TEST_CASE("yieldIncompleteRowTerminates", "[reader]")
+{
+    std::vector<size_t> counts;
+    for(int two_stage = 0; two_stage < 2; two_stage++) {
+        INFO("two_stage = " << two_stage);
+        StringCursor cursor("a,b\nc,\"d\ne\"");
+        CsvReader<StringCursor> reader(cursor, ',', '"', 0, true);
+        reader.set_two_stage(two_stage);
+
+        size_t rows = 0;
+        while(reader.read_row()) {
+            REQUIRE(++rows <= 2);
+        }
+        counts.push_back(rows);
+    }
+    REQUIRE(counts == std::vector<size_t>({2, 2}));
+}
+
+
+TEST_CASE("projection", "[reader]")
+{
+    std::string s = "a,\"b,\n\",c,d,e\n"
+                    "f,g\n"
+                    "\n"
+                    "h,i,\"j\"\"\",\"k\nl\",\"m,\nn\",o\r\n"
+                    "p,,q,r" + std::string(200, 'x') + ",\"" +
+                    std::string(200, '\n') + "\",s\n";
+    s += "t,u,v";
+    for(int i = 0; i < 40; i++) {
+        s += ",\"w\"\"\r" + std::string(i, 'w') + "\"";
+    }
+    s += "\n";
+    StringCursor full_cursor(s);
+    Rows full = read_all(full_cursor, false);
+    REQUIRE(full.size() == 5);
+
+    for(const std::vector<size_t> &columns : std::vector<std::vector<size_t>>{
+            {0}, {1}, {2}, {0, 2}, {3, 1}, {5}, {10}}) {
+        Rows expect;
+        for(auto &row : full) {
+            std::vector<std::string> cells;
+            for(size_t i : columns) {
+                if(i < row.size()) {
+                    cells.push_back(row[i]);
+                }
+            }
+            expect.push_back(cells);
+        }
+
+        for(int k = csvmonkey::kCsmKernelFallback; k <= csvmonkey::kCsmKernelAvx512; k++) {
+            auto kernel = (csvmonkey::CsmKernel) k;
+            if(! csvmonkey::kernel_supported(kernel)) {
+                continue;
+            }
+
+            INFO("kernel = " << csvmonkey::kernel_name(kernel));
+            for(int two_stage = 0; two_stage < 2; two_stage++) {
+                INFO("two_stage = " << two_stage);
+                StringCursor cursor(s);
+                REQUIRE(read_all(cursor, two_stage, kernel, columns) == expect);
+
+                for(size_t chunk : {1, 7, 64}) {
+                    INFO("chunk = " << chunk);
+                    ChunkedCursor chunked(s, chunk);
+                    REQUIRE(read_all(chunked, two_stage, kernel, columns) == expect);
+                }
+            }
+        }
+    }
+}
+
+
+TEST_CASE("projectionLimitsCount", "[reader]")
+{
+    StringCursor cursor("a,b,c,d\ne\n");
+    CsvReader<StringCursor> reader(cursor);
+    reader.set_columns({1});
+
+    REQUIRE(reader.read_row());
+    REQUIRE(reader.row().count == 2);
+    REQUIRE(reader.row().cells[1].as_str() == "b");
+    REQUIRE(reader.read_row());
+    REQUIRE(reader.row().count == 1);
+    REQUIRE(! reader.read_row());
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+#include "temp_file.hpp"
+
+
+using csvmonkey::BufferCursor;
+using csvmonkey::CsvReader;
+using csvmonkey::RowIndexer;
+
+
+/**
+ * Return the first cell of each row read from `s`.
+ */
+static std::vector<std::string>
+read_first_cells(const std::string &s, size_t limit=~(size_t)0)
+{
+    BufferCursor cursor(s.data(), s.data() + s.size());
+    CsvReader<BufferCursor> reader(cursor);
+    std::vector<std::string> out;
+    while(out.size() < limit && reader.read_row()) {
+        out.push_back(reader.row().cells[0].as_str());
+    }
+    return out;
+}
+
+
+/**
+ * Verify RowIndexer agrees with CsvReader, and also finds any final record
+ * lacking a newline when yield_incomplete_row is true.
+ */
+static void
+check(const std::string &s)
+{
+    std::vector<std::string> expect = read_first_cells(s);
+
+    // Terminating the input completes any final record.
+    bool quoted = std::count(s.begin(), s.end(), '"') % 2;
+    size_t incomplete = read_first_cells(s + (quoted ? "\"\n" : "\n")).size()
+                      - expect.size();
+
+    for(int k = csvmonkey::kCsmKernelFallback; k <= csvmonkey::kCsmKernelAvx512; k++) {
+        auto kernel = (csvmonkey::CsmKernel) k;
+        if(! csvmonkey::kernel_supported(kernel)) {
+            continue;
+        }
+
+        INFO("kernel = " << csvmonkey::kernel_name(kernel));
+        RowIndexer indexer('"', false, kernel);
+        REQUIRE(indexer.count(s.data(), s.size()) == expect.size());
+
+        std::vector<uint64_t> offsets;
+        REQUIRE(indexer.index(s.data(), s.size(), offsets) == expect.size());
+        REQUIRE(offsets.size() == expect.size());
+        for(size_t i = 0; i < offsets.size(); i++) {
+            INFO("i = " << i);
+            auto got = read_first_cells(s.substr(offsets[i]), 1);
+            REQUIRE(got.size() == 1);
+            REQUIRE(got[0] == expect[i]);
+        }
+
+        RowIndexer yield_indexer('"', true, kernel);
+        std::vector<uint64_t> yield_offsets;
+        yield_indexer.index(s.data(), s.size(), yield_offsets);
+        REQUIRE(yield_offsets.size() == expect.size() + incomplete);
+        REQUIRE(std::equal(offsets.begin(), offsets.end(),
+                           yield_offsets.begin()));
+    }
+}
+
+
+TEST_CASE("rowIndexerBasic", "[rowindexer]")
+{
+    check("");
+    check("\n\r\n");
+    check("a,b\nc,d\n");
+    check("a,b\nc,d");
+    check("\r\na\r\n\r\n\nb\r\n,\n");
+    check("a,\"b\nc\"\nd,\"e\"\"\n\"\n");
+    check("a\n\"unterminated\n");
+}
+
+
+TEST_CASE("rowIndexerRandom", "[rowindexer]")
+{
+    // Quotes may only appear around entire fields.
+    const char *const quoted[] = {"a", ",", "\n", "\r", "\"\""};
+    const char *const separators[] = {",", "\n", "\r\n", "\n\n"};
+
+    std::mt19937 rng(1234);
+    for(int i = 0; i < 300; i++) {
+        std::string s;
+        size_t fields = rng() % 40;
+        for(size_t j = 0; j < fields; j++) {
+            size_t len = rng() % 80;
+            if(rng() % 2) {
+                s += "\"";
+                for(size_t k = 0; k < len; k++) {
+                    s += quoted[rng() % 5];
+                }
+                // Occasionally leave the final field unterminated.
+                if((j + 1) < fields || rng() % 4) {
+                    s += "\"";
+                }
+            } else {
+                s += std::string(len, 'b');
+            }
+            if((j + 1) < fields || rng() % 2) {
+                s += separators[rng() % 4];
+            }
+        }
+
+        INFO("s = " << s);
+        check(s);
+    }
+}
+
+
+TEST_CASE("countRowsMappedFile", "[rowindexer]")
+{
+    std::string s = "a,b\n\"c\nd\",e\nf,g\n";
+    TempFile file(s);
+    csvmonkey::MappedFileCursor stream;
+    stream.open(file.path.c_str());
+
+    REQUIRE(csvmonkey::count_rows(stream) == 3);
+    REQUIRE(csvmonkey::build_row_index(stream) == std::vector<uint64_t>({0, 4, 12}));
+    REQUIRE(stream.size() == s.size());
+}
+
+
+TEST_CASE("rowIndexerFind", "[rowindexer]")
+{
+    std::string s = "a\n\n\"b\nc\"\nd\r\ne";
+    RowIndexer indexer;
+    REQUIRE(indexer.find(s.data(), s.size(), 0) == 0);
+    REQUIRE(indexer.find(s.data(), s.size(), 1) == 3);
+    REQUIRE(indexer.find(s.data(), s.size(), 2) == 9);
+    // An unterminated final record is only found if it would be yielded.
+    REQUIRE(indexer.find(s.data(), s.size(), 3) == s.size());
+    REQUIRE(indexer.find(s.data(), s.size(), 4) == s.size());
+    REQUIRE(RowIndexer('"', true).find(s.data(), s.size(), 3) == 12);
+
+    std::vector<uint64_t> offsets;
+    REQUIRE(indexer.index(s.data(), s.size(), offsets, 2) == 3);
+    REQUIRE(offsets == std::vector<uint64_t>({0, 9}));
+
+    // find() agrees with count(), including when the last record spans
+    // several blocks, with or without its newline.
+    std::string x(200, 'x');
+    std::string quoted = "\"" + std::string(100, '\n') + "\"";
+    for(std::string t : {std::string("a\nb\nc"), std::string("a\nb\nc\n"),
+                         "a\n" + x, "a\n" + x + "\n", "a\n" + quoted + "\n\n"}) {
+        for(bool incomplete : {false, true}) {
+            RowIndexer ri('"', incomplete);
+            size_t n = ri.count(t.data(), t.size());
+            INFO("t = " << t << ", incomplete = " << incomplete);
+            REQUIRE(ri.find(t.data(), t.size(), n) == t.size());
+            REQUIRE(ri.find(t.data(), t.size(), n - 1) < t.size());
+        }
+    }
+}
+
+
+TEST_CASE("seekRecord", "[rowindexer]")
+{
+    std::string s = "\n";
+    for(int i = 0; i < 1000; i++) {
+        s += std::to_string(i) + ((i % 3) ? ",x\n" : ",\"y\ny\"\r\n\n");
+    }
+    TempFile file(s);
+    std::string index_path = csvmonkey::RowOffsetIndex::sidecar_path(file.path);
+
+    csvmonkey::MappedFileCursor stream;
+    stream.open(file.path.c_str());
+    CsvReader<csvmonkey::MappedFileCursor> reader(stream);
+
+    csvmonkey::RowOffsetIndex index;
+    REQUIRE(! index.load(index_path, stream));
+    index.build(stream, 64);
+    REQUIRE(index.rows() == 1000);
+    index.save(index_path);
+
+    csvmonkey::RowOffsetIndex loaded;
+    REQUIRE(loaded.load(index_path, stream));
+    REQUIRE(loaded.rows() == 1000);
+    REQUIRE(loaded.stride() == 64);
+
+    // Parsing options are part of the index.
+    csvmonkey::RowOffsetIndex other('\'');
+    REQUIRE(! other.load(index_path, stream));
+
+    // Truncated sidecars, or those claiming more samples than they hold.
+    std::ifstream in(index_path, std::ios::binary);
+    std::string sidecar((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+    csvmonkey::RowOffsetIndex corrupt;
+    TempFile truncated(sidecar.substr(0, sidecar.size() - 8));
+    REQUIRE(! corrupt.load(truncated.path, stream));
+    uint64_t samples = 1ULL << 60;
+    sidecar.replace(56, sizeof samples, (const char *) &samples, sizeof samples);
+    TempFile oversized(sidecar);
+    REQUIRE(! corrupt.load(oversized.path, stream));
+
+    for(size_t n : {0, 1, 63, 64, 65, 500, 999, 500, 0}) {
+        INFO("n = " << n);
+        REQUIRE(reader.seek_record(n, loaded));
+        REQUIRE(reader.read_row());
+        REQUIRE(reader.row().cells[0].as_str() == std::to_string(n));
+    }
+    REQUIRE(! reader.seek_record(1000, loaded));
+    unlink(index_path.c_str());
+}
+
+
+TEST_CASE("rowOffsetIndexRejectsModifiedFile", "[rowindexer]")
+{
+    TempFile file("a\nb\n");
+    std::string index_path = csvmonkey::RowOffsetIndex::sidecar_path(file.path);
+    {
+        csvmonkey::MappedFileCursor stream;
+        stream.open(file.path.c_str());
+        csvmonkey::RowOffsetIndex index;
+        index.build(stream);
+        index.save(index_path);
+    }
+
+    // Same size, but different content and modification time.
+    FILE *fp = fopen(file.path.c_str(), "w");
+    REQUIRE(fp);
+    fputs("c\nd\n", fp);
+    fclose(fp);
+
+    csvmonkey::MappedFileCursor stream;
+    stream.open(file.path.c_str());
+    csvmonkey::RowOffsetIndex index;
+    REQUIRE(! index.load(index_path, stream));
+    unlink(index_path.c_str());
+}
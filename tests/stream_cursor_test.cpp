@@ -0,0 +1,724 @@
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+#include "temp_file.hpp"
+
+
+using csvmonkey::BufferCursor;
+using csvmonkey::CsvReader;
+using csvmonkey::FdStreamCursor;
+using csvmonkey::IoUringStreamCursor;
+using csvmonkey::MappedFileCursor;
+using csvmonkey::MultiFileCursor;
+using csvmonkey::ODirectStreamCursor;
+using csvmonkey::ReadAheadStreamCursor;
+using Rows = std::vector<std::vector<std::string>>;
+
+
+template<class Cursor>
+static Rows
+read_rows(Cursor &cursor, bool yield_incomplete_row=false)
+{
+    CsvReader<Cursor> reader(cursor, ',', '"', 0, yield_incomplete_row);
+    Rows rows;
+    auto &row = reader.row();
+    while(reader.read_row()) {
+        std::vector<std::string> cells;
+        for(size_t i = 0; i < row.count; i++) {
+            cells.push_back(row.cells[i].as_str());
+        }
+        rows.push_back(cells);
+    }
+    return rows;
+}
+
+
+static Rows
+read_string(const std::string &s)
+{
+    BufferCursor cursor(s.data(), s.data() + s.size());
+    return read_rows(cursor);
+}
+
+
+static std::string
+make_input()
+{
+    std::string s;
+    for(int i = 0; i < 20000; i++) {
+        s += std::to_string(i) + ",\"quoted, " + std::string(i % 97, 'x')
+           + "\nfield\"," + std::to_string(i * 7) + "\n";
+    }
+    return s;
+}
+
+
+/**
+ * Return a descriptor for an already deleted temporary file holding `s`.
+ */
+static int
+open_temp(const std::string &s)
+{
+    TempFile file(s);
+    return file.open();
+}
+
+
+TEST_CASE("ioUringFile", "[cursor]")
+{
+    std::string s = make_input();
+    Rows expect = read_string(s);
+    int fd = open_temp(s);
+
+    for(int uring = 0; uring < 2; uring++) {
+        INFO("uring = " << uring);
+        for(size_t depth : {1, 4}) {
+            INFO("depth = " << depth);
+            for(size_t block_size : {1, 65536}) {
+                INFO("block_size = " << block_size);
+                IoUringStreamCursor cursor(fd, depth, block_size, uring);
+                REQUIRE(read_rows(cursor) == expect);
+            }
+        }
+    }
+
+    // Reading starts from the current file position.
+    size_t header = s.find("\n1,");
+    REQUIRE(lseek(fd, header + 1, SEEK_SET) == (off_t) header + 1);
+    IoUringStreamCursor cursor(fd);
+    REQUIRE(read_rows(cursor) == read_string(s.substr(header + 1)));
+    close(fd);
+}
+
+
+TEST_CASE("ioUringPipe", "[cursor]")
+{
+    std::string s = make_input();
+    Rows expect = read_string(s);
+
+    for(int uring = 0; uring < 2; uring++) {
+        INFO("uring = " << uring);
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+
+        // Dribble input in pieces smaller than a block.
+        std::thread writer([&] {
+            for(size_t pos = 0; pos < s.size(); pos += 1000) {
+                size_t n = std::min((size_t) 1000, s.size() - pos);
+                if(write(fds[1], &s[pos], n) != (ssize_t) n) {
+                    break;
+                }
+            }
+            close(fds[1]);
+        });
+
+        {
+            IoUringStreamCursor cursor(fds[0], 4, 4096, uring);
+            REQUIRE(read_rows(cursor) == expect);
+        }
+        writer.join();
+        close(fds[0]);
+    }
+}
+
+
+TEST_CASE("ioUringPipeAbandoned", "[cursor]")
+{
+    // Destroying the cursor must not wait for input that never arrives.
+    for(int uring = 0; uring < 2; uring++) {
+        INFO("uring = " << uring);
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        REQUIRE(write(fds[1], "a,b\n", 4) == 4);
+        {
+            IoUringStreamCursor cursor(fds[0], 4, 4096, uring);
+            CsvReader<IoUringStreamCursor> reader(cursor);
+            REQUIRE(reader.read_row());
+        }
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+
+TEST_CASE("fdStreamCursorIncompleteRow", "[cursor]")
+{
+    // Previously fill() kept reporting success at EOF while unparsed input
+    // remained, so the reader never returned.
+    std::string s = "a,b\nc,d";
+    BufferCursor buffer(s.data(), s.data() + s.size());
+    Rows expect = read_rows(buffer, true);
+    REQUIRE(expect.size() == 2);
+
+    int fd = open_temp(s);
+    FdStreamCursor cursor(fd);
+    REQUIRE(read_rows(cursor, true) == expect);
+    close(fd);
+}
+
+
+/**
+ * Source producing `s` in `chunk` byte reads, then throwing if `fail` is set.
+ */
+class ChunkedSource
+    : public csvmonkey::BufferedStreamCursor
+{
+    std::string s_;
+    size_t chunk_;
+    size_t pos_;
+    bool fail_;
+
+    public:
+    ChunkedSource(const std::string &s, size_t chunk, bool fail=false)
+        : s_(s)
+        , chunk_(chunk)
+        , pos_(0)
+        , fail_(fail)
+    {
+    }
+
+    ssize_t readmore()
+    {
+        size_t n = std::min(chunk_, s_.size() - pos_);
+        if(! n) {
+            if(fail_) {
+                throw csvmonkey::Error("test", "read failed");
+            }
+            return -1;
+        }
+        ensure(n);
+        memcpy(&vec_[write_pos_], &s_[pos_], n);
+        pos_ += n;
+        return n;
+    }
+};
+
+
+/**
+ * Count hook invocations, checking they nest correctly.
+ */
+class HookedCursor
+    : public ReadAheadStreamCursor
+{
+    public:
+    std::atomic<int> sources;
+    std::atomic<int> in_source;
+    int waits;
+    bool in_wait;
+
+    HookedCursor(csvmonkey::StreamCursor &source)
+        : ReadAheadStreamCursor(source, 2, 16)
+        , sources(0)
+        , in_source(0)
+        , waits(0)
+        , in_wait(false)
+    {
+    }
+
+    ~HookedCursor()
+    {
+        stop();
+    }
+
+    protected:
+    void source_begin()
+    {
+        sources++;
+        in_source++;
+    }
+
+    void source_end()
+    {
+        in_source--;
+    }
+
+    void wait_begin()
+    {
+        waits += ! in_wait;
+        in_wait = true;
+    }
+
+    void wait_end()
+    {
+        in_wait = false;
+    }
+};
+
+
+TEST_CASE("readAhead", "[cursor]")
+{
+    std::string s = make_input();
+    Rows expect = read_string(s);
+
+    for(size_t depth : {1, 4}) {
+        INFO("depth = " << depth);
+        for(size_t chunk : {100, 4096, 1 << 20}) {
+            INFO("chunk = " << chunk);
+            ChunkedSource source(s, chunk);
+            ReadAheadStreamCursor cursor(source, depth);
+            REQUIRE(read_rows(cursor) == expect);
+        }
+    }
+
+    // Sources that start with data, and never fill().
+    TempFile file(s);
+    MappedFileCursor mapped;
+    mapped.open(file.path.c_str());
+    ReadAheadStreamCursor cursor(mapped);
+    REQUIRE(read_rows(cursor) == expect);
+}
+
+
+TEST_CASE("readAheadRethrows", "[cursor]")
+{
+    ChunkedSource source("a,b\nc,d\n", 3, true);
+    ReadAheadStreamCursor cursor(source);
+    REQUIRE_THROWS_AS(read_rows(cursor), csvmonkey::Error &);
+}
+
+
+TEST_CASE("readAheadHooks", "[cursor]")
+{
+    std::string s = make_input();
+    ChunkedSource source(s, 100);
+    {
+        HookedCursor cursor(source);
+        REQUIRE(read_rows(cursor) == read_string(s));
+        REQUIRE(cursor.in_source == 0);
+        REQUIRE(cursor.sources > 0);
+        REQUIRE(! cursor.in_wait);
+    }
+
+    // Destroyed before reaching EOF.
+    ChunkedSource source2(s, 100);
+    HookedCursor cursor(source2);
+    CsvReader<HookedCursor> reader(cursor);
+    REQUIRE(reader.read_row());
+}
+
+
+TEST_CASE("mirroredBuffer", "[cursor]")
+{
+    csvmonkey::MirroredBuffer buf(1);
+    size_t capacity = buf.capacity();
+    REQUIRE(capacity >= 1);
+    if(! buf.mirrored()) {
+        WARN("memfd_create() unavailable, mirroring not tested");
+        return;
+    }
+
+    for(size_t i = 0; i < capacity; i++) {
+        buf[i] = (char) i;
+    }
+    size_t mismatched = 0;
+    for(size_t i = 0; i < capacity; i++) {
+        mismatched += buf[capacity + i] != (char) i;
+    }
+    REQUIRE(mismatched == 0);
+    buf[(2 * capacity) - 1] = 'x';
+    REQUIRE(buf[capacity - 1] == 'x');
+    REQUIRE(buf[2 * capacity] == buf[0]);
+}
+
+
+TEST_CASE("bufferedLongRows", "[cursor]")
+{
+    // Rows repeatedly wrapping the ring, and rows forcing it to grow.
+    std::string s;
+    for(size_t size : {100, 70000, 5, 300000, 131072, 1 << 20, 3}) {
+        s += "a," + std::string(size, 'x') + ",\"" + std::string(size / 2, 'y')
+           + "\"\n";
+    }
+
+    Rows expect = read_string(s);
+    REQUIRE(expect.size() == 7);
+    for(size_t chunk : {1000, 65536, 1 << 21}) {
+        INFO("chunk = " << chunk);
+        ChunkedSource cursor(s, chunk);
+        REQUIRE(read_rows(cursor) == expect);
+    }
+}
+
+
+/**
+ * Return the number of open file descriptors.
+ */
+static size_t
+count_fds()
+{
+    size_t n = 0;
+    for(int fd = 0; fd < 1024; fd++) {
+        n += fcntl(fd, F_GETFD) != -1;
+    }
+    return n;
+}
+
+
+TEST_CASE("oDirect", "[cursor]")
+{
+    std::string s = make_input();
+    s += "a," + std::string(100000, 'x') + "\nlast,row";
+    Rows expect = read_string(s + "\n");
+    expect.pop_back();
+
+    TempFile file(s);
+    for(size_t block_size : {1, 65536, 1 << 20}) {
+        INFO("block_size = " << block_size);
+        ODirectStreamCursor cursor(block_size);
+        cursor.open(file.path.c_str());
+        if(! cursor.direct()) {
+            WARN("O_DIRECT unsupported by /tmp");
+        }
+        REQUIRE(read_rows(cursor) == expect);
+    }
+
+    // Each fill() leaves trailing NULs.
+    ODirectStreamCursor cursor(4096);
+    cursor.open(file.path.c_str());
+    std::string got;
+    while(cursor.fill()) {
+        REQUIRE(std::string(cursor.buf() + cursor.size(), 31)
+                == std::string(31, '\0'));
+        got.append(cursor.buf(), cursor.size());
+        cursor.consume(cursor.size());
+    }
+    REQUIRE(got == s);
+
+    // Reopening closes the previous file, and starts from the beginning.
+    size_t fds = count_fds();
+    cursor.open(file.path.c_str());
+    REQUIRE(count_fds() == fds);
+    REQUIRE(read_rows(cursor) == expect);
+
+    ODirectStreamCursor missing;
+    REQUIRE_THROWS_AS(missing.open("/nonexistent/file"), csvmonkey::Error &);
+}
+
+
+/**
+ * Return the resident size of the mapping containing `p`, in KiB.
+ */
+static size_t
+mapping_rss_kb(const void *p)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool found = false;
+    while(std::getline(smaps, line)) {
+        unsigned long start, end;
+        if(sscanf(line.c_str(), "%lx-%lx ", &start, &end) == 2) {
+            found = (uintptr_t) p >= start && (uintptr_t) p < end;
+        } else if(found && line.compare(0, 4, "Rss:") == 0) {
+            return strtoul(line.c_str() + 4, 0, 10);
+        }
+    }
+    return 0;
+}
+
+
+TEST_CASE("mappedFileWindow", "[cursor]")
+{
+    std::string s;
+    while(s.size() < (16 << 20)) {
+        s += std::to_string(s.size()) + ",\"" + std::string(1000, 'x')
+           + "\"\n";
+    }
+
+    TempFile file(s);
+    for(int windowed = 0; windowed < 2; windowed++) {
+        INFO("windowed = " << windowed);
+        MappedFileCursor cursor;
+        if(windowed) {
+            cursor.set_window(1 << 20);
+        }
+        cursor.open(file.path.c_str());
+
+        CsvReader<MappedFileCursor> reader(cursor);
+        size_t rows = 0;
+        size_t max_rss = 0;
+        while(reader.read_row()) {
+            if(! (++rows % 1000)) {
+                max_rss = std::max(max_rss, mapping_rss_kb(cursor.startp()));
+            }
+        }
+        INFO("max_rss = " << max_rss);
+        REQUIRE(rows == (size_t) std::count(s.begin(), s.end(), '\n'));
+        if(windowed) {
+            REQUIRE(max_rss < 4096);
+        } else {
+            REQUIRE(max_rss > 8192);
+        }
+
+        // Seeking backwards faults dropped pages back in.
+        cursor.seek(0);
+        reader.reset();
+        REQUIRE(reader.read_row());
+        REQUIRE(reader.row().cells[0].as_str() == "0");
+    }
+}
+
+
+TEST_CASE("mappedFileFlags", "[cursor]")
+{
+    std::string s = make_input();
+    Rows expect = read_string(s);
+
+    TempFile file(s);
+    for(int flags = 0; flags < 8; flags++) {
+        for(size_t window : {0, 65536}) {
+            INFO("flags = " << flags << ", window = " << window);
+            MappedFileCursor cursor;
+            cursor.set_window(window);
+            cursor.open(file.path.c_str(), flags);
+            if(flags & csvmonkey::kCsmMapHugePages) {
+                REQUIRE(! ((uintptr_t) cursor.startp() & ((2 << 20) - 1)));
+            }
+            REQUIRE(read_rows(cursor) == expect);
+        }
+    }
+
+    // Reopened, then destroyed, while the prefault thread may still be
+    // running.
+    MappedFileCursor cursor;
+    cursor.set_window(4096);
+    cursor.open(file.path.c_str(), csvmonkey::kCsmMapPrefault);
+    cursor.open(file.path.c_str(), csvmonkey::kCsmMapPrefault);
+    REQUIRE(read_rows(cursor) == expect);
+    cursor.open(file.path.c_str(), csvmonkey::kCsmMapPrefault);
+}
+
+
+#ifdef USE_ZLIB
+/**
+ * Compress `s` as one gzip member.
+ */
+static std::string
+gzip(const std::string &s)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    REQUIRE(deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string out(deflateBound(&zs, s.size()), '\0');
+    zs.next_in = (Bytef *) s.data();
+    zs.avail_in = s.size();
+    zs.next_out = (Bytef *) &out[0];
+    zs.avail_out = out.size();
+    REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+
+TEST_CASE("gzipStreamCursor", "[cursor]")
+{
+    std::string s = make_input();
+    Rows expect = read_string(s);
+
+    // Two members, split mid-row.
+    size_t split = s.size() / 3;
+    std::string gz = gzip(s.substr(0, split)) + gzip("") + gzip(s.substr(split));
+
+    for(size_t input_size : {1, 4096, 1 << 20}) {
+        INFO("input_size = " << input_size);
+        int fd = open_temp(gz);
+        csvmonkey::GzipStreamCursor cursor(fd, input_size);
+        REQUIRE(read_rows(cursor) == expect);
+        close(fd);
+    }
+
+    // Decompressing on a read-ahead thread.
+    int fd = open_temp(gz);
+    csvmonkey::GzipStreamCursor source(fd);
+    ReadAheadStreamCursor cursor(source);
+    REQUIRE(read_rows(cursor) == expect);
+    close(fd);
+}
+
+
+TEST_CASE("gzipStreamCursorErrors", "[cursor]")
+{
+    std::string gz = gzip(make_input());
+    for(auto bad : {gz.substr(0, gz.size() / 2), std::string("not gzip\n")}) {
+        int fd = open_temp(bad);
+        csvmonkey::GzipStreamCursor cursor(fd);
+        REQUIRE_THROWS_AS(read_rows(cursor), csvmonkey::Error &);
+        close(fd);
+    }
+}
+#endif // USE_ZLIB
+
+
+#ifdef USE_ZSTD
+/**
+ * Compress `s` as one zstd frame per `frame_size` bytes, optionally omitting
+ * their decompressed sizes.
+ */
+static std::string
+zstd(const std::string &s, size_t frame_size, bool content_size=true)
+{
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 3);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, content_size);
+    std::string out;
+    for(size_t pos = 0; pos < s.size(); pos += frame_size) {
+        size_t n = std::min(frame_size, s.size() - pos);
+        std::string frame(ZSTD_compressBound(n), '\0');
+        ZSTD_outBuffer zout = { &frame[0], frame.size(), 0 };
+        ZSTD_inBuffer zin = { s.data() + pos, n, 0 };
+        size_t rc = ZSTD_compressStream2(cctx, &zout, &zin, ZSTD_e_end);
+        REQUIRE(rc == 0);
+        frame.resize(zout.pos);
+        out += frame;
+    }
+    ZSTD_freeCCtx(cctx);
+    return out;
+}
+
+
+TEST_CASE("zstdStreamCursor", "[cursor]")
+{
+    std::string s = make_input();
+    Rows expect = read_string(s);
+
+    // A skippable frame, as used for the seekable format's seek table.
+    std::string skippable("\x50\x2a\x4d\x18\x04\0\0\0abcd", 12);
+    std::string multi = zstd(s, 4096) + skippable;
+
+    for(size_t threads : {1, 4}) {
+        INFO("threads = " << threads);
+        for(const std::string &zs : {zstd(s, s.size()), multi}) {
+            int fd = open_temp(zs);
+            csvmonkey::ZstdStreamCursor cursor(fd, threads);
+            REQUIRE(read_rows(cursor) == expect);
+            close(fd);
+        }
+    }
+
+    // Frames larger than max_frame_size fall back to streaming.
+    int fd = open_temp(zstd(s, 4096) + zstd(s, s.size()));
+    csvmonkey::ZstdStreamCursor cursor(fd, 4, 1 << 16);
+    REQUIRE(read_rows(cursor) == read_string(s + s));
+    close(fd);
+
+    // Frames exceeding max_buffered are decompressed by the caller, whether
+    // their size is declared or found by a worker.
+    for(bool content_size : {true, false}) {
+        INFO("content_size = " << content_size);
+        std::string zs = zstd(s, 4096, content_size) +
+                         zstd(s, 40000, content_size) + skippable;
+        int fd = open_temp(zs);
+        csvmonkey::ZstdStreamCursor cursor(fd, 4, 1 << 20, 20000);
+        REQUIRE(read_rows(cursor) == read_string(s + s));
+        close(fd);
+    }
+}
+
+
+TEST_CASE("zstdStreamCursorErrors", "[cursor]")
+{
+    std::string zs = zstd(make_input(), 4096);
+    for(size_t threads : {1, 4}) {
+        INFO("threads = " << threads);
+        for(auto bad : {zs.substr(0, zs.size() / 2), std::string("not zstd\n")}) {
+            int fd = open_temp(bad);
+            csvmonkey::ZstdStreamCursor cursor(fd, threads);
+            REQUIRE_THROWS_AS(read_rows(cursor), csvmonkey::Error &);
+            close(fd);
+        }
+    }
+}
+#endif // USE_ZSTD
+
+
+static Rows
+read_files(const std::vector<std::string> &parts, bool header=true)
+{
+    std::deque<TempFile> files;
+    std::vector<std::string> paths;
+    for(auto &part : parts) {
+        files.emplace_back(part);
+        paths.push_back(files.back().path);
+    }
+
+    MultiFileCursor cursor(paths, header);
+    return read_rows(cursor, true);
+}
+
+
+TEST_CASE("multiFileCursor", "[cursor]")
+{
+    std::string header = "id,\"text\nheader\",n\n";
+    std::string body = make_input();
+    Rows expect = read_string(header + body);
+
+    // Split at row boundaries, including empty and header-only parts.
+    std::vector<std::string> parts = {header};
+    size_t pos = 0;
+    for(size_t split : {body.size() / 3, body.size() / 2, body.size()}) {
+        size_t end = std::min(body.size(), body.find("\n", split) + 1);
+        if(split == body.size()) {
+            end = split;
+        }
+        parts.push_back(header + body.substr(pos, end - pos));
+        pos = end;
+    }
+    parts.insert(parts.begin() + 2, "");
+    REQUIRE(read_files(parts) == expect);
+
+    // Windows line endings in a repeated header are accepted.
+    REQUIRE(read_files({"a,b\n1,2\n", "a,b\r\n3,4\n"})
+            == Rows({{"a", "b"}, {"1", "2"}, {"3", "4"}}));
+
+    // Missing final newlines, and a quoted field left open across files,
+    // whose header is still dropped.
+    REQUIRE(read_files({"a,b\n1,2", "a,b\n3,\"4\n", "a,b\n\"\n5,6\n"})
+            == Rows({{"a", "b"}, {"1", "2"}, {"3", "4\n"}, {"5", "6"}}));
+
+    // Without headers, files are simply concatenated.
+    REQUIRE(read_files({"a,b\n", "a,b\n1,2\n"}, false)
+            == Rows({{"a", "b"}, {"a", "b"}, {"1", "2"}}));
+}
+
+
+TEST_CASE("multiFileCursorErrors", "[cursor]")
+{
+    REQUIRE_THROWS_AS(read_files({"a,b\n1,2\n", "a,c\n3,4\n"}), csvmonkey::Error &);
+    REQUIRE_THROWS_AS(MultiFileCursor({}), csvmonkey::Error &);
+    REQUIRE_THROWS_AS(MultiFileCursor({"/nonexistent"}), csvmonkey::Error &);
+
+    TempFile file("a,b\n1,2\n");
+    MultiFileCursor cursor({file.path, "/nonexistent"});
+    Rows rows;
+    REQUIRE_THROWS_AS(rows = read_rows(cursor), csvmonkey::Error &);
+    REQUIRE(cursor.file_index() == 0);
+
+    // Errors are sticky, rather than the next fill() failing to join the
+    // prefetch thread, or moving on to the following file.
+    REQUIRE_THROWS_AS(cursor.fill(), csvmonkey::Error &);
+    REQUIRE_THROWS_AS(cursor.fill(), csvmonkey::Error &);
+
+    // The mismatched file's header is never presented as data.
+    TempFile other("a,c\n3,4\n");
+    TempFile last("a,b\n5,6\n");
+    MultiFileCursor mismatched({file.path, other.path, last.path});
+    CsvReader<MultiFileCursor> reader(mismatched);
+    REQUIRE(reader.read_row());
+    REQUIRE(reader.read_row());
+    REQUIRE(reader.row().cells[1].as_str() == "2");
+    for(int i = 0; i < 3; i++) {
+        REQUIRE_THROWS_AS(reader.read_row(), csvmonkey::Error &);
+        REQUIRE(mismatched.file_index() == 0);
+    }
+}
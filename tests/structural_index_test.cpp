@@ -0,0 +1,102 @@
+#include <random>
+#include <string>
+
+#include "catch.hpp"
+#include "csvmonkey.hpp"
+
+
+static uint64_t
+prefix_xor_reference(uint64_t bits)
+{
+    uint64_t out = 0;
+    bool odd = false;
+    for(int i = 0; i < 64; i++) {
+        odd ^= (bits >> i) & 1;
+        out |= (uint64_t) odd << i;
+    }
+    return out;
+}
+
+
+TEST_CASE("prefixXor", "[structuralindex]")
+{
+    std::mt19937_64 rng(1234);
+    for(int i = 0; i < 1000; i++) {
+        uint64_t bits = rng();
+        INFO("bits = " << bits);
+        REQUIRE(csvmonkey::prefix_xor_shift(bits) == prefix_xor_reference(bits));
+#ifdef CSM_X86
+        if(csvmonkey::kernel_supported(csvmonkey::kCsmKernelAvx2)) {
+            REQUIRE(csvmonkey::prefix_xor_clmul(bits) == prefix_xor_reference(bits));
+        }
+#endif
+    }
+}
+
+
+TEST_CASE("quoteRegionsCarry", "[structuralindex]")
+{
+    using Kernel = csvmonkey::FallbackKernel;
+    uint64_t state = 0;
+    // Quote opens at bit 60 and remains open into the next block.
+    REQUIRE(csvmonkey::quote_regions<Kernel>(1ULL << 60, state) == (0xfULL << 60));
+    REQUIRE(state == ~0ULL);
+    // Closed at bit 3 of the next block.
+    REQUIRE(csvmonkey::quote_regions<Kernel>(1ULL << 3, state) == 0x7ULL);
+    REQUIRE(state == 0);
+}
+
+
+TEST_CASE("buildSkipsQuotedStructurals", "[structuralindex]")
+{
+    std::string s = "a,\"b,\"\"\n\",c\n";
+    s += std::string(100, 'x') + ",\"" + std::string(100, ',') + "\"\n";
+
+    std::vector<uint32_t> expect;
+    for(size_t i = 0; i < s.size(); i++) {
+        bool structural = (s[i] == ',' || s[i] == '\n');
+        bool quoted = (i >= 2 && i <= 8) || (i >= 113 && i <= 213);
+        if(structural && !quoted) {
+            expect.push_back(i);
+        }
+    }
+
+    for(int k = csvmonkey::kCsmKernelFallback; k <= csvmonkey::kCsmKernelAvx512; k++) {
+        auto kernel = (csvmonkey::CsmKernel) k;
+        if(! csvmonkey::kernel_supported(kernel)) {
+            continue;
+        }
+
+        INFO("kernel = " << csvmonkey::kernel_name(kernel));
+        csvmonkey::StructuralIndex index(',', '"', kernel);
+        index.build(s.data(), s.size());
+
+        std::vector<uint32_t> got(index.offsets.begin(),
+                                  index.offsets.begin() + index.count);
+        REQUIRE(got == expect);
+    }
+}
+
+
+TEST_CASE("countQuotes", "[structuralindex]")
+{
+    std::string s;
+    size_t expect = 0;
+    for(int i = 0; i < 300; i++) {
+        s += (i % 3) ? 'x' : '"';
+        expect += !(i % 3);
+    }
+
+    for(int k = csvmonkey::kCsmKernelFallback; k <= csvmonkey::kCsmKernelAvx512; k++) {
+        auto kernel = (csvmonkey::CsmKernel) k;
+        if(! csvmonkey::kernel_supported(kernel)) {
+            continue;
+        }
+
+        INFO("kernel = " << csvmonkey::kernel_name(kernel));
+        csvmonkey::StructuralIndex index(',', '"', kernel);
+        REQUIRE(index.count_quotes(s.data(), s.size()) == expect);
+        REQUIRE(index.count_quotes(s.data() + 1, 64) == 21);
+        REQUIRE(index.count_quotes(s.data(), 0) == 0);
+    }
+}
@@ -0,0 +1,45 @@
+#include <string>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "catch.hpp"
+
+
+/**
+ * Temporary file holding `s`, deleted on destruction.
+ */
+class TempFile
+{
+    public:
+    std::string path;
+
+    TempFile(const std::string &s)
+    {
+        char tmpl[] = "/tmp/csvmonkey_test.XXXXXX";
+        int fd = mkstemp(tmpl);
+        REQUIRE(fd != -1);
+        REQUIRE(write(fd, s.data(), s.size()) == (ssize_t) s.size());
+        close(fd);
+        path = tmpl;
+    }
+
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+
+    ~TempFile()
+    {
+        unlink(path.c_str());
+    }
+
+    /**
+     * Return a new read-only descriptor for the file.
+     */
+    int open() const
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        REQUIRE(fd != -1);
+        return fd;
+    }
+};